@@ -0,0 +1,239 @@
+/*
+ *  arena.h
+ *  Created on: Oct 17, 2026
+ *
+ *  Copyright (c) 2026 by Leo Hoo
+ *  lion@9465.net
+ */
+
+#ifndef _ex_arena_h__
+#define _ex_arena_h__
+
+#include <stdint.h>
+#include <stddef.h>
+#include <assert.h>
+#include <new>
+
+namespace exlib {
+
+class arena_chunk {
+public:
+    arena_chunk* m_next;
+    size_t m_size;
+};
+
+/*
+ * Bump allocator for short-lived temporaries. Memory comes from chunks
+ * and is never freed one block at a time; reset() or the end of a Scope
+ * gives back everything allocated since. Chunks of the default size go
+ * to the current worker's cache and are reused by the next arena that
+ * grows on it, larger ones go straight back to malloc.
+ *
+ * current() is an arena owned by the running fiber (or OS thread) and is
+ * released with it. It is NULL before Service::init() and on threads exlib
+ * did not start; the default Scope and ArenaAllocator use current(), so
+ * code that can run there has to pass an Arena of its own. An arena must
+ * only be used by one fiber at a time.
+ */
+class Arena {
+public:
+    enum {
+        CHUNK_SIZE = 32 * 1024 - sizeof(arena_chunk),
+        // larger requests get a chunk of their own
+        LARGE_SIZE = CHUNK_SIZE / 4
+    };
+
+    class Mark {
+    public:
+        Mark()
+            : m_chunk(NULL)
+            , m_pos(0)
+            , m_end(0)
+        {
+        }
+
+        Mark(arena_chunk* chunk, intptr_t pos, intptr_t end)
+            : m_chunk(chunk)
+            , m_pos(pos)
+            , m_end(end)
+        {
+        }
+
+    public:
+        arena_chunk* m_chunk;
+        intptr_t m_pos;
+        intptr_t m_end;
+    };
+
+    class Scope {
+    public:
+        Scope()
+            : m_arena(*checked(current()))
+            , m_mark(m_arena.mark())
+        {
+        }
+
+        Scope(Arena& arena)
+            : m_arena(arena)
+            , m_mark(arena.mark())
+        {
+        }
+
+        ~Scope()
+        {
+            m_arena.reset(m_mark);
+        }
+
+    private:
+        static Arena* checked(Arena* arena)
+        {
+            assert(arena != NULL);
+            return arena;
+        }
+
+    private:
+        Arena& m_arena;
+        Mark m_mark;
+    };
+
+public:
+    Arena()
+        : m_chunk(NULL)
+        , m_pos(0)
+        , m_end(0)
+    {
+    }
+
+    ~Arena()
+    {
+        reset();
+    }
+
+public:
+    void* alloc(size_t sz, size_t align = sizeof(void*))
+    {
+        intptr_t p = (m_pos + (intptr_t)align - 1) & ~((intptr_t)align - 1);
+
+        if (p + (intptr_t)sz <= m_end) {
+            m_pos = p + sz;
+            return (void*)p;
+        }
+
+        return grow(sz, align);
+    }
+
+    template <typename T>
+    T* alloc(size_t n = 1)
+    {
+        return (T*)alloc(n * sizeof(T), alignof(T));
+    }
+
+    Mark mark() const
+    {
+        return Mark(m_chunk, m_pos, m_end);
+    }
+
+    void reset(const Mark& m);
+
+    void reset()
+    {
+        reset(Mark());
+    }
+
+public:
+    // NULL before Service::init() and on threads that exlib did not start
+    static Arena* current();
+
+private:
+    void* grow(size_t sz, size_t align);
+    static arena_chunk* get_chunk(size_t sz);
+    static void put_chunk(arena_chunk* chunk);
+
+private:
+    // m_chunk heads the list of every chunk in use, [m_pos, m_end) is the
+    // free part of the one being bumped, which large blocks never are
+    arena_chunk* m_chunk;
+    intptr_t m_pos;
+    intptr_t m_end;
+};
+
+// std allocator over an arena, deallocate is a no-op
+template <typename T>
+class ArenaAllocator {
+public:
+    typedef T value_type;
+    typedef T* pointer;
+    typedef const T* const_pointer;
+    typedef T& reference;
+    typedef const T& const_reference;
+    typedef size_t size_type;
+    typedef ptrdiff_t difference_type;
+
+    template <typename U>
+    struct rebind {
+        typedef ArenaAllocator<U> other;
+    };
+
+public:
+    ArenaAllocator()
+        : m_arena(Arena::current())
+    {
+        assert(m_arena != NULL);
+    }
+
+    ArenaAllocator(Arena& arena)
+        : m_arena(&arena)
+    {
+    }
+
+    template <typename U>
+    ArenaAllocator(const ArenaAllocator<U>& v)
+        : m_arena(v.m_arena)
+    {
+    }
+
+public:
+    T* allocate(size_t n)
+    {
+        return m_arena->alloc<T>(n);
+    }
+
+    void deallocate(T* p, size_t n)
+    {
+    }
+
+    template <typename U, typename... Args>
+    void construct(U* p, Args&&... args)
+    {
+        new ((void*)p) U(static_cast<Args&&>(args)...);
+    }
+
+    template <typename U>
+    void destroy(U* p)
+    {
+        p->~U();
+    }
+
+    size_t max_size() const
+    {
+        return SIZE_MAX / sizeof(T);
+    }
+
+    template <typename U>
+    bool operator==(const ArenaAllocator<U>& v) const
+    {
+        return m_arena == v.m_arena;
+    }
+
+    template <typename U>
+    bool operator!=(const ArenaAllocator<U>& v) const
+    {
+        return m_arena != v.m_arena;
+    }
+
+public:
+    Arena* m_arena;
+};
+}
+
+#endif
@@ -0,0 +1,60 @@
+/*
+ *  asyncpool.h
+ *  Created on: Oct 17, 2026
+ *
+ *  Copyright (c) 2026 by Leo Hoo
+ *  lion@9465.net
+ */
+
+#ifndef _ex_asyncpool_h__
+#define _ex_asyncpool_h__
+
+#include <stdint.h>
+
+namespace exlib {
+
+/*
+ * OS threads for calls that block in the kernel or in a library (dns,
+ * fsync, database engines). run_blocking suspends the calling fiber, runs
+ * func on a pool thread and reschedules the fiber when func returns, so
+ * the Service worker keeps running other fibers meanwhile. called from a
+ * plain thread, func simply runs inline.
+ */
+class AsyncPool {
+public:
+    class Stats {
+    public:
+        int32_t threads;
+        int32_t idle;
+        int32_t maxThreads;
+        intptr_t queued;
+        intptr_t maxQueued;
+        intptr_t running;
+        int64_t completed;
+        int64_t waitTime;
+    };
+
+public:
+    static void init(int32_t threads);
+    static int32_t size();
+
+    static void run_blocking(void (*func)(void*), void* data);
+
+    template <typename F>
+    static void run_blocking(F func)
+    {
+        run_blocking(invoke<F>, &func);
+    }
+
+    static void stats(Stats& s);
+
+private:
+    template <typename F>
+    static void invoke(void* p)
+    {
+        (*(F*)p)();
+    }
+};
+}
+
+#endif
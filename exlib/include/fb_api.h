@@ -17,8 +17,14 @@ typedef void (*fiber_func)(void*);
 
 void* convert_Fiber(void* param);
 void* create_fiber(size_t stacksize, fiber_func proc, void* param);
+void* reset_fiber(void* fiber, size_t stacksize, fiber_func proc, void* param);
 void switch_fiber(void* from, void* to);
 void delete_fiber(void* fiber);
+
+// give every new stack a mapping of its own with a PROT_NONE page below it.
+// off by default: each guarded stack costs two of the vm.max_map_count
+// mappings, which caps a process near 32k fibers
+void set_stack_guard(bool guard);
 }
 
 #endif // _db_api_h__
\ No newline at end of file
@@ -18,11 +18,57 @@
 namespace exlib {
 
 #define TLS_SIZE 8
+#define TLS_MAX 1024
 
 class Locker;
+class Task_base;
+class Service;
+
+class TimerNode : public linkitem {
+public:
+    enum {
+        IDLE = 0,
+        WAIT,
+        SIGNALED,
+        TIMEOUT
+    };
+
+public:
+    TimerNode(Task_base* task)
+        : m_task(task)
+        , m_slot(NULL)
+        , m_expire(0)
+        , m_lock(NULL)
+        , m_blocks(NULL)
+    {
+    }
+
+public:
+    bool claim();
+
+    bool timeout()
+    {
+        m_lock = NULL;
+        m_blocks = NULL;
+        return m_state.xchg(IDLE) == TIMEOUT;
+    }
+
+public:
+    Task_base* m_task;
+    void* m_slot;
+    int64_t m_expire;
+    atomic m_state;
+    spinlock* m_lock;
+    List<Task_base>* m_blocks;
+};
 
 class Task_base : public linkitem {
 public:
+    Task_base()
+        : m_timer(this)
+    {
+    }
+
     virtual ~Task_base()
     {
     }
@@ -30,18 +76,24 @@ public:
 public:
     virtual void suspend() = 0;
     virtual void suspend(spinlock& lock) = 0;
+    virtual void suspend(spinlock& lock, List<Task_base>& blocks, int64_t us);
     virtual void resume() = 0;
 
     virtual bool is(int32_t t)
     {
         return false;
     }
+
+public:
+    TimerNode m_timer;
 };
 
 class Thread_base : public Task_base {
 public:
     Thread_base()
-        : m_stackguard(0)
+        : m_tlsExt(NULL)
+        , m_tlsExtSize(0)
+        , m_stackguard(0)
     {
         memset(&m_tls, 0, sizeof(m_tls));
     }
@@ -87,8 +139,13 @@ public:
 protected:
     virtual void destroy();
 
+private:
+    void** tlsSlot(int32_t idx);
+
 private:
     void* m_tls[TLS_SIZE];
+    void** m_tlsExt;
+    int32_t m_tlsExtSize;
     intptr_t m_stackguard;
     atomic refs_;
 };
@@ -99,11 +156,25 @@ public:
         : m_recursive(recursive)
         , m_count(0)
         , m_locker(0)
+        , m_service(0)
+        , m_spin(SPIN_MIN)
     {
+        memset(&m_stats, 0, sizeof(m_stats));
     }
 
+public:
+    class Stats {
+    public:
+        int64_t acquired;
+        int64_t contended;
+        int64_t spun;
+        int64_t parked;
+        int64_t handoffs;
+    };
+
 public:
     bool lock(Task_base* current = NULL);
+    bool timedlock(int64_t us, Task_base* current = NULL);
     void unlock(Task_base* current = NULL);
     bool trylock(Task_base* current = NULL);
     bool owned(Task_base* current = NULL);
@@ -119,12 +190,31 @@ public:
         return cnt;
     }
 
+    void stats(Stats& s)
+    {
+        m_lock.lock();
+        s = m_stats;
+        m_lock.unlock();
+    }
+
+private:
+    enum {
+        SPIN_MIN = 16,
+        SPIN_MAX = 2048
+    };
+
+    bool spin(Task_base* current);
+    void acquire(Task_base* current);
+
 private:
     bool m_recursive;
     int32_t m_count;
     spinlock m_lock;
     List<Task_base> m_blocks;
     Task_base* m_locker;
+    Service* m_service;
+    int32_t m_spin;
+    Stats m_stats;
 };
 
 class autoLocker {
@@ -153,6 +243,7 @@ public:
 
 public:
     void wait();
+    bool wait(int64_t us);
     void pulse();
     void set();
     void reset();
@@ -178,6 +269,7 @@ private:
 class CondVar {
 public:
     void wait(Locker& l);
+    bool wait(Locker& l, int64_t us);
     void notify_one();
     void notify_all();
 
@@ -206,6 +298,7 @@ public:
 
 public:
     void wait();
+    bool wait(int64_t us);
     void post();
     bool trywait();
 
@@ -226,6 +319,42 @@ private:
     List<Task_base> m_blocks;
 };
 
+class RWLocker {
+public:
+    RWLocker()
+        : m_readers(0)
+        , m_writer(false)
+    {
+    }
+
+public:
+    void rlock();
+    bool tryrlock();
+    void runlock();
+
+    void wlock();
+    bool trywlock();
+    void wunlock();
+
+    int32_t count()
+    {
+        int32_t cnt;
+
+        m_lock.lock();
+        cnt = m_readBlocks.count() + m_writeBlocks.count();
+        m_lock.unlock();
+
+        return cnt;
+    }
+
+private:
+    int32_t m_readers;
+    bool m_writer;
+    spinlock m_lock;
+    List<Task_base> m_readBlocks;
+    List<Task_base> m_writeBlocks;
+};
+
 template <class T>
 class Queue {
 public:
@@ -238,14 +367,14 @@ public:
     T* get()
     {
         m_sem.wait();
-        return m_list.getHead();
+        return pop();
     }
 
     T* tryget()
     {
         if (!m_sem.trywait())
             return 0;
-        return m_list.getHead();
+        return pop();
     }
 
     bool empty()
@@ -258,9 +387,173 @@ public:
         return m_list.count();
     }
 
+private:
+    T* pop()
+    {
+        T* pNow;
+
+        m_lock.lock();
+        while ((pNow = m_list.getHead()) == 0)
+            yield();
+        m_lock.unlock();
+
+        return pNow;
+    }
+
 public:
-    LockedList<T> m_list;
+    MPSCList<T> m_list;
     Semaphore m_sem;
+
+private:
+    spinlock m_lock;
+};
+
+template <class T>
+class Channel {
+public:
+    Channel(int32_t size = 1)
+        : m_size(size > 0 ? size : 1)
+        , m_head(0)
+        , m_count(0)
+        , m_closed(false)
+    {
+        m_buf = new T[m_size];
+    }
+
+    ~Channel()
+    {
+        delete[] m_buf;
+    }
+
+public:
+    bool send(const T& v)
+    {
+        m_lock.lock();
+
+        while (m_count == m_size && !m_closed) {
+            Task_base* current = Thread_base::current();
+            assert(current != 0);
+
+            m_sendBlocks.putTail(current);
+            current->suspend(m_lock);
+            m_lock.lock();
+        }
+
+        return put(v);
+    }
+
+    bool trysend(const T& v)
+    {
+        m_lock.lock();
+
+        if (m_count == m_size) {
+            m_lock.unlock();
+            return false;
+        }
+
+        return put(v);
+    }
+
+    bool recv(T& v)
+    {
+        m_lock.lock();
+
+        while (m_count == 0 && !m_closed) {
+            Task_base* current = Thread_base::current();
+            assert(current != 0);
+
+            m_recvBlocks.putTail(current);
+            current->suspend(m_lock);
+            m_lock.lock();
+        }
+
+        return get(v);
+    }
+
+    bool tryrecv(T& v)
+    {
+        m_lock.lock();
+        return get(v);
+    }
+
+    void close()
+    {
+        List<Task_base> blocks;
+        Task_base* fb;
+
+        m_lock.lock();
+        m_closed = true;
+        m_sendBlocks.getList(blocks);
+        while ((fb = m_recvBlocks.getHead()) != 0)
+            blocks.putTail(fb);
+        m_lock.unlock();
+
+        while ((fb = blocks.getHead()) != 0)
+            fb->resume();
+    }
+
+    int32_t count()
+    {
+        int32_t cnt;
+
+        m_lock.lock();
+        cnt = m_count;
+        m_lock.unlock();
+
+        return cnt;
+    }
+
+    int32_t size() const
+    {
+        return m_size;
+    }
+
+private:
+    bool put(const T& v)
+    {
+        if (m_closed) {
+            m_lock.unlock();
+            return false;
+        }
+
+        m_buf[(m_head + m_count++) % m_size] = v;
+        Task_base* fb = m_recvBlocks.getHead();
+        m_lock.unlock();
+
+        if (fb)
+            fb->resume();
+
+        return true;
+    }
+
+    bool get(T& v)
+    {
+        if (m_count == 0) {
+            m_lock.unlock();
+            return false;
+        }
+
+        v = m_buf[m_head];
+        m_head = (m_head + 1) % m_size;
+        m_count--;
+        Task_base* fb = m_sendBlocks.getHead();
+        m_lock.unlock();
+
+        if (fb)
+            fb->resume();
+
+        return true;
+    }
+
+private:
+    int32_t m_size;
+    int32_t m_head;
+    int32_t m_count;
+    bool m_closed;
+    T* m_buf;
+    spinlock m_lock;
+    List<Task_base> m_sendBlocks;
+    List<Task_base> m_recvBlocks;
 };
 
 #define FIBER_STACK_SIZE (65536 * 2)
@@ -274,6 +567,13 @@ public:
         : m_pService(pService)
         , m_func(func)
         , m_data(data)
+        , m_readyAt(0)
+        , m_runTime(0)
+        , m_waitTime(0)
+        , m_posts(0)
+        , m_stacksize(0)
+        , m_priority(PRIORITY_NORMAL)
+        , m_deadline(0)
     {
         m_ctx = NULL;
         memset(&name_, 0, sizeof(name_));
@@ -286,8 +586,14 @@ public:
         return t == type;
     }
 
+    enum {
+        PRIORITY_NORMAL = 0,
+        PRIORITY_BATCH
+    };
+
     virtual void suspend();
     virtual void suspend(spinlock& lock);
+    virtual void suspend(spinlock& lock, List<Task_base>& blocks, int64_t us);
     virtual void resume();
 
     void join();
@@ -308,8 +614,35 @@ public:
         return name_;
     }
 
+    // microseconds spent running, and (sampled) spent runnable in a run queue
+    int64_t runTime() const
+    {
+        return m_runTime;
+    }
+
+    int64_t waitTime() const
+    {
+        return m_waitTime;
+    }
+
+    // batch fibers only run when no latency fiber is runnable, or when
+    // Service::setBatchWeight lets one through. once a batch fiber is past
+    // its deadline it is scheduled as a latency fiber.
+    void set_priority(int32_t priority)
+    {
+        m_priority = priority;
+    }
+
+    int32_t priority() const
+    {
+        return m_priority;
+    }
+
+    void set_deadline(int64_t us);
+
 public:
     static void sleep(int32_t ms, Task_base* now = 0);
+    static void usleep(int64_t us, Task_base* now = 0);
     static void cancel_sleep(Task_base* now);
 
     static Fiber* current();
@@ -322,9 +655,15 @@ public:
     void* m_data;
     char name_[16];
 
-#ifdef DEBUG
+    int64_t m_readyAt;
+    int64_t m_runTime;
+    int64_t m_waitTime;
+    int32_t m_posts;
+    int32_t m_stacksize;
+    int32_t m_priority;
+    int64_t m_deadline;
+
     linkitem m_link;
-#endif
 };
 }
 
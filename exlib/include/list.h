@@ -206,6 +206,11 @@ public:
         return false;
     }
 
+    bool linked(T* o) const
+    {
+        return o->m_next != 0 || o->m_prev != 0 || m_first == o;
+    }
+
     bool empty() const
     {
         return m_count == 0;
@@ -363,6 +368,189 @@ public:
 private:
     spinlock m_lock;
 };
+
+template <typename T>
+class MPSCList {
+public:
+    MPSCList()
+        : m_last(&m_stub)
+        , m_first(&m_stub)
+    {
+    }
+
+    void putTail(T* pNew)
+    {
+        assert(pNew->m_inlist == 0);
+        assert(pNew->m_next == 0);
+        assert(pNew->m_prev == 0);
+
+#ifdef DEBUG
+        pNew->m_inlist = this;
+#endif
+
+        m_count.inc();
+        push(pNew);
+    }
+
+    // only one consumer at a time, callers serialize getHead themselves.
+    // may return NULL while a producer is half way through putTail.
+    T* getHead()
+    {
+        linkitem* pNow = m_first;
+        linkitem* pNext = load_next(pNow);
+
+        if (pNow == &m_stub) {
+            if (pNext == 0)
+                return 0;
+
+            m_first = pNext;
+            pNow = pNext;
+            pNext = load_next(pNext);
+        }
+
+        if (pNext == 0) {
+            if (pNow != m_last)
+                return 0;
+
+            push(&m_stub);
+            pNext = load_next(pNow);
+            if (pNext == 0)
+                return 0;
+        }
+
+        m_first = pNext;
+        pNow->m_next = 0;
+
+#ifdef DEBUG
+        assert(pNow->m_inlist == this);
+        pNow->m_inlist = 0;
+#endif
+
+        m_count.dec();
+        return (T*)pNow;
+    }
+
+    bool empty() const
+    {
+        return m_count <= 0;
+    }
+
+    int32_t count() const
+    {
+        intptr_t c = m_count;
+        return c > 0 ? (int32_t)c : 0;
+    }
+
+private:
+    void push(linkitem* pNew)
+    {
+        pNew->m_next = 0;
+        linkitem* pPrev = m_last.xchg(pNew);
+        *(linkitem* volatile*)&pPrev->m_next = pNew;
+    }
+
+    static linkitem* load_next(linkitem* p)
+    {
+        return *(linkitem* volatile*)&p->m_next;
+    }
+
+private:
+    atomic_ptr<linkitem> m_last;
+    linkitem* m_first;
+    linkitem m_stub;
+    atomic m_count;
+};
+
+template <typename T, int32_t SIZE>
+class MPMCRing {
+public:
+    MPMCRing()
+    {
+        int32_t i;
+
+        assert((SIZE & (SIZE - 1)) == 0);
+        for (i = 0; i < SIZE; i++)
+            m_cells[i].m_seq = i;
+    }
+
+    bool put(T* pNew)
+    {
+        intptr_t pos = m_tail;
+        cell* c;
+
+        while (true) {
+            c = &m_cells[pos & (SIZE - 1)];
+            intptr_t dif = c->m_seq - pos;
+
+            if (dif == 0) {
+                intptr_t p = m_tail.CompareAndSwap(pos, pos + 1);
+                if (p == pos)
+                    break;
+                pos = p;
+            } else if (dif < 0)
+                return false;
+            else
+                pos = m_tail;
+        }
+
+        c->m_data = pNew;
+        MemoryBarrier();
+        c->m_seq = pos + 1;
+
+        return true;
+    }
+
+    T* get()
+    {
+        intptr_t pos = m_head;
+        cell* c;
+
+        while (true) {
+            c = &m_cells[pos & (SIZE - 1)];
+            intptr_t dif = c->m_seq - (pos + 1);
+
+            if (dif == 0) {
+                intptr_t p = m_head.CompareAndSwap(pos, pos + 1);
+                if (p == pos)
+                    break;
+                pos = p;
+            } else if (dif < 0)
+                return 0;
+            else
+                pos = m_head;
+        }
+
+        MemoryBarrier();
+        T* pNow = c->m_data;
+        MemoryBarrier();
+        c->m_seq = pos + SIZE;
+
+        return pNow;
+    }
+
+    bool empty() const
+    {
+        return m_tail <= m_head;
+    }
+
+    int32_t count() const
+    {
+        intptr_t c = m_tail - m_head;
+        return c > 0 ? (int32_t)c : 0;
+    }
+
+private:
+    struct cell {
+        atomic m_seq;
+        T* volatile m_data;
+    };
+
+    atomic m_head;
+    char m_pad1[64 - sizeof(atomic)];
+    atomic m_tail;
+    char m_pad2[64 - sizeof(atomic)];
+    cell m_cells[SIZE];
+};
 }
 
 #endif
@@ -0,0 +1,55 @@
+/*
+ *  profiler.h
+ *  Created on: Oct 17, 2026
+ *
+ *  Copyright (c) 2026 by Leo Hoo
+ *  lion@9465.net
+ */
+
+#ifndef _ex_profiler_h__
+#define _ex_profiler_h__
+
+#include <stdint.h>
+#include <string>
+
+namespace exlib {
+
+class Service;
+
+/*
+ * Sampling profiler that knows about fibers. While started, every worker
+ * running a fiber is interrupted with SIGPROF each interval and the fiber's
+ * name and native stack are recorded. folded() renders the samples as
+ * "name;outer;...;leaf count" lines, the input format of flamegraph.pl.
+ * fibers() renders the stacks of all suspended fibers in the same format;
+ * it briefly keeps workers from switching into fibers while it walks them.
+ *
+ * Samples are taken in the signal handler and follow frame pointers, the
+ * only walk that is safe there: code built with -fomit-frame-pointer shows
+ * up as the interrupted frame and whatever frames above it kept theirs.
+ * Linux release builds keep frame pointers for this (tools/basic.cmake).
+ * Suspended stacks are unwound from DWARF tables on amd64 and follow the
+ * frame records nix_switch saved on arm64; elsewhere they are reported as
+ * "[stack not walked]". Frames are printed as symbol+offset when dladdr
+ * can resolve them and as module+offset otherwise. Sampling is Linux only.
+ */
+class Profiler {
+public:
+    static bool start(int32_t interval_us = 1000);
+    static void stop();
+    static void reset();
+
+    static int64_t samples();
+    static void folded(std::string& out);
+    static void fibers(std::string& out);
+
+private:
+    friend class prof_sampler;
+
+    static void on_signal(int32_t sig, void* info, void* context);
+    static void sample(Service* worker, void* context);
+    static void kick();
+};
+}
+
+#endif
@@ -17,6 +17,12 @@
 
 namespace exlib {
 
+#ifdef _WIN32
+typedef wchar_t wchar;
+#else
+typedef uint16_t wchar;
+#endif
+
 template <typename T>
 inline size_t qstrlen(const T* pStr)
 {
@@ -118,13 +124,76 @@ inline const T* qmemfind(const T* s1, size_t sz1, const T* s2, size_t sz2)
     return NULL;
 }
 
-#define MAX_SMALL 16
+template <typename T>
+inline int32_t qmemicmp(const T* s1, const T* s2, size_t count)
+{
+    if (s1 == s2)
+        return 0;
+
+    int32_t n;
+
+    while (count--) {
+        n = qtolower(*s1++) - qtolower(*s2++);
+        if (n != 0)
+            return n;
+    }
+
+    return 0;
+}
+
+template <typename T>
+inline void qmemlower(T* ptr, size_t num)
+{
+    while (num--) {
+        *ptr = qtolower(*ptr);
+        ptr++;
+    }
+}
+
+template <typename T>
+inline void qmemupper(T* ptr, size_t num)
+{
+    while (num--) {
+        *ptr = qtoupper(*ptr);
+        ptr++;
+    }
+}
+
+// vectorized versions for char and wchar in src/qstring.cpp, the sse2,
+// avx2 or neon kernels are picked at runtime from what the cpu supports
+const char* qmemfind(const char* s1, size_t sz1, const char* s2, size_t sz2);
+int32_t qmemicmp(const char* s1, const char* s2, size_t count);
+void qmemlower(char* ptr, size_t num);
+void qmemupper(char* ptr, size_t num);
+
+size_t qstrlen(const wchar* pStr);
+void qmemlower(wchar* ptr, size_t num);
+void qmemupper(wchar* ptr, size_t num);
+
+enum {
+    QSTR_AUTO = -1,
+    QSTR_SCALAR = 0,
+    QSTR_SSE2,
+    QSTR_AVX2,
+    QSTR_NEON
+};
+
+// forces one kernel set, so tests can run every path the build has.
+// false when the build or the cpu lacks it, QSTR_AUTO goes back to the best
+bool qstr_kernels(int32_t kernels);
+
 #define SSO_MARK (1LL << (sizeof(size_t) * 8 - 1))
 #define SSO_MASK (SIZE_MAX ^ SSO_MARK)
 
 template <typename T>
 class basic_string {
 private:
+    // inline capacity in elements including the terminator, 24 bytes for
+    // char so keys up to 23 chars never reach the heap
+    enum {
+        MAX_SMALL = sizeof(T) == 1 ? 24 : 16
+    };
+
 #pragma pack(1)
     struct buffer {
         atomic refs_;
@@ -186,6 +255,15 @@ public:
         assign(v);
     }
 
+    basic_string(basic_string<T>&& v)
+        : m_length(v.m_length)
+    {
+        memcpy(m_small_data, v.m_small_data, sizeof(m_small_data));
+
+        v.m_length = 0;
+        v.m_small_data[0] = 0;
+    }
+
     ~basic_string()
     {
         unref();
@@ -279,6 +357,11 @@ public:
 
                 m_buffer = _buffer;
             } else if (blk_size > m_buffer->blk_size) {
+                // grow by half again so appending in a loop stays linear
+                size_t grow = m_buffer->blk_size + (m_buffer->blk_size >> 1);
+                if (blk_size < grow)
+                    blk_size = (grow + 15) & (SIZE_MAX - 15);
+
                 m_buffer = (buffer*)realloc(m_buffer, blk_size * sizeof(T) + sizeof(buffer));
                 m_buffer->blk_size = blk_size;
             }
@@ -316,6 +399,20 @@ public:
         return sz1 > sz2 ? 1 : -1;
     }
 
+    int32_t icompare(const basic_string<T>& str) const
+    {
+        const T* s1 = c_str();
+        size_t sz1 = length();
+        size_t sz2 = str.length();
+
+        size_t sz = sz1 > sz2 ? sz2 : sz1;
+        int32_t r = qmemicmp(s1, str.c_str(), sz);
+        if (r != 0 || sz1 == sz2)
+            return r;
+
+        return sz1 > sz2 ? 1 : -1;
+    }
+
     int32_t compare(const T* str) const
     {
         const T* s1 = c_str();
@@ -379,6 +476,9 @@ public:
 
     basic_string<T>& assign(const basic_string<T>& str)
     {
+        if (this == &str)
+            return *this;
+
         unref();
 
         if (str.is_sso()) {
@@ -469,24 +569,18 @@ public:
 public:
     void tolower()
     {
-        T* buf = c_buffer();
         size_t sz = length();
 
-        while (sz--) {
-            *buf = qtolower(*buf);
-            buf++;
-        }
+        if (sz)
+            qmemlower(c_buffer(), sz);
     }
 
     void toupper()
     {
-        T* buf = c_buffer();
         size_t sz = length();
 
-        while (sz--) {
-            *buf = qtoupper(*buf);
-            buf++;
-        }
+        if (sz)
+            qmemupper(c_buffer(), sz);
     }
 
 public:
@@ -530,17 +624,17 @@ public:
         return c_buffer()[i];
     }
 
-    basic_string<T> operator+=(T ch)
+    basic_string<T>& operator+=(T ch)
     {
         return append(1, ch);
     }
 
-    basic_string<T> operator+=(const T* rhs)
+    basic_string<T>& operator+=(const T* rhs)
     {
         return append(rhs);
     }
 
-    basic_string<T> operator+=(const basic_string<T>& rhs)
+    basic_string<T>& operator+=(const basic_string<T>& rhs)
     {
         return append(rhs);
     }
@@ -555,6 +649,21 @@ public:
         return assign(str);
     }
 
+    basic_string<T>& operator=(basic_string<T>&& str)
+    {
+        if (this != &str) {
+            unref();
+
+            m_length = str.m_length;
+            memcpy(m_small_data, str.m_small_data, sizeof(m_small_data));
+
+            str.m_length = 0;
+            str.m_small_data[0] = 0;
+        }
+
+        return *this;
+    }
+
 private:
     size_t m_length;
     union {
@@ -730,12 +839,6 @@ bool operator!=(const T* lhs,
     return rhs.compare(lhs) != 0;
 }
 
-#ifdef _WIN32
-typedef wchar_t wchar;
-#else
-typedef uint16_t wchar;
-#endif
-
 typedef basic_string<char> string;
 typedef basic_string<wchar> wstring;
 }
@@ -0,0 +1,44 @@
+/*
+ *  reactor.h
+ *  Created on: Oct 17, 2026
+ *
+ *  Copyright (c) 2026 by Leo Hoo
+ *  lion@9465.net
+ */
+
+#ifndef _ex_reactor_h__
+#define _ex_reactor_h__
+
+#include "osconfig.h"
+
+#ifndef _WIN32
+
+#include <stdint.h>
+#include <stddef.h>
+#include <sys/socket.h>
+
+namespace exlib {
+
+/*
+ * fd readiness for fibers. A fiber that waits is suspended and, whichever
+ * worker sees the fd become ready, rescheduled on the worker it last ran on;
+ * plain threads fall back to a blocking poll(). fds passed to read/write/accept must be non-blocking.
+ * timeouts are in microseconds, negative means forever. on Linux the workers
+ * drive a shared epoll set, elsewhere every call falls back to poll().
+ */
+class Reactor {
+public:
+    static bool wait_readable(int32_t fd, int64_t us = -1);
+    static bool wait_writable(int32_t fd, int64_t us = -1);
+
+    static intptr_t read(int32_t fd, void* buf, size_t len, int64_t us = -1);
+    static intptr_t write(int32_t fd, const void* buf, size_t len, int64_t us = -1);
+    static int32_t accept(int32_t fd, sockaddr* addr, socklen_t* addrlen, int64_t us = -1);
+
+    static int32_t close(int32_t fd);
+};
+}
+
+#endif
+
+#endif
@@ -15,11 +15,16 @@
 
 namespace exlib {
 
+class arena_chunk;
+
 class Service : public OSThread {
 private:
     Service();
     Service(int32_t workers);
 
+    friend class Profiler;
+    friend class Arena;
+
 public:
     static const int32_t type = 2;
     virtual bool is(int32_t t)
@@ -34,55 +39,97 @@ public:
         m_main.saveStackGuard();
         m_main.m_ctx = convert_Fiber(NULL);
 
+        m_master->attach(this);
+        bind();
         m_master->m_idleWorkers.dec();
         dispatch_loop();
     }
 
 private:
     void dispatch_loop();
+    void account(Fiber* fb, int64_t now);
+
+    void attach(Service* worker);
+    void bind();
+    static Service* master();
+
+    void put_local(Fiber* fiber, bool fifo, bool batch);
+    Fiber* get_local();
+    Fiber* get_inbox(bool wait);
+    Fiber* get_batch(bool wait);
+    void promote_batch();
+    Fiber* steal();
+    Fiber* spin();
+
+    int32_t cache_bucket(int32_t stacksize, bool create);
+    Fiber* reuse(fiber_func func, void* data, int32_t stacksize);
+    arena_chunk* reuse_chunk();
+    bool recycle_chunk(arena_chunk* chunk);
+    void trim_cache();
 
 public:
-    static void init(int32_t workers);
+    // worker placement: unpinned, one core per worker, or one NUMA node per
+    // worker. stealing prefers victims on the thief's node either way. the
+    // thread that calls init() and every non-worker thread keep the process
+    // mask.
+    enum {
+        AFFINITY_NONE = 0,
+        AFFINITY_CORE,
+        AFFINITY_NODE
+    };
+
+    static void init(int32_t workers, int32_t affinity = AFFINITY_NONE);
     static Service* current();
     static void init();
+    static int32_t cpus();
 
+    // latency-class fibers picked per batch fiber while both are runnable
+    static void setBatchWeight(int32_t weight);
+
+    // nothing is scheduled and *retVal is NULL when no stack could be mapped
     static void Create(fiber_func func, void* data, int32_t stacksize,
         const char* name = NULL, Fiber** retVal = NULL);
 
-    void post(Fiber* fiber)
-    {
-        if (m_master)
-            m_master->post(fiber);
-        else {
-            m_resumeList.putTail(fiber);
-            m_sem.Post();
-        }
-    }
+    void post(Fiber* fiber, bool fifo = false);
+    void post_home(Fiber* fiber);
+    Fiber* next();
 
-    Fiber* next()
-    {
-        if (m_master)
-            return m_master->next();
+    void wakeup();
+    bool unpark();
 
-        Fiber* fb;
+    bool recycle(Fiber* fb);
 
-        m_idleWorkers.inc();
+    // workers drop the fibers and arena chunks they cache at their next
+    // tick. js::Runtime::gc() calls it along with the engine's low memory gc
+    static void trim();
 
-        m_sem.Wait();
-        fb = m_resumeList.getHead();
+public:
+    class WorkerStats {
+    public:
+        int32_t runnable;
+        int64_t switches;
+        int64_t maxSlice;
+        char maxSliceName[16];
+    };
 
-        if (m_idleWorkers.dec() == 0 && m_workers > 0) {
-            if (m_workers.dec() < 0)
-                m_workers.inc();
-            else {
-                m_idleWorkers.inc();
-                Service* worker = new Service();
-                worker->start();
-            }
-        }
+    class Stats {
+    public:
+        int32_t workers;
+        int32_t idleWorkers;
+        int32_t spinning;
+        int32_t runnable;
+        int32_t timers;
+        int64_t created;
+        int64_t destroyed;
+        int64_t recycled;
+        int32_t cached;
+        int64_t switches;
+        int64_t maxSlice;
+        char maxSliceName[16];
+    };
 
-        return fb;
-    }
+    static int32_t stats(Stats& s, WorkerStats* workers = NULL, int32_t count = 0);
+    static void resetMaxSlice();
 
     Fiber* running()
     {
@@ -115,26 +162,80 @@ public:
         switchConext();
     }
 
-#ifdef DEBUG
 public:
+    static void forEach(void (*func)(Fiber*, void*), void* data);
     static void forEach(void (*func)(Fiber*));
-#endif
+
+private:
+    void freeze_wait();
+    static void thaw();
 
 private:
     static void fiber_proc(fiber_func func, Fiber* fb);
 
 private:
+    enum {
+        RUNQ_SIZE = 256,
+        SPIN_ROUNDS = 64,
+        STATS_SAMPLE = 8,
+        FIBER_CACHE = 64,
+        FIBER_BUCKETS = 4,
+        CHUNK_CACHE = 64
+    };
+
     Service* m_master;
 
     Fiber m_main;
 
     Fiber* m_running;
+    exlib::atomic m_inFiber;
+    exlib::atomic m_frozen;
+    OSSemaphore m_thaw;
     switchConextCallback* m_cb;
 
     exlib::atomic m_workers;
     exlib::atomic m_idleWorkers;
-    LockedList<Fiber> m_resumeList;
+    exlib::atomic m_spinning;
+
+    Service** m_pool;
+    exlib::atomic m_poolSize;
+    int32_t m_poolCap;
+
+    int32_t m_index;
+    int32_t m_node;
+
+    int32_t m_tick;
+    atomic_ptr<Fiber> m_lifo;
+    MPMCRing<Fiber, RUNQ_SIZE> m_runq;
+    MPSCList<Fiber> m_inbox;
+    exlib::atomic m_inboxBusy;
+
+    int32_t m_batchTurn;
+    MPMCRing<Fiber, RUNQ_SIZE> m_batchq;
+    MPSCList<Fiber> m_batchInbox;
+    exlib::atomic m_batchBusy;
+
+    exlib::atomic m_parked;
+    exlib::atomic m_inPoll;
     OSSemaphore m_sem;
+
+    int64_t m_now;
+    int64_t m_switches;
+    int64_t m_sliceStart;
+    int64_t m_maxSlice;
+    char m_maxSliceName[16];
+    spinlock m_statsLock;
+
+    Fiber* m_fiberCache[FIBER_BUCKETS];
+    int32_t m_cacheStack[FIBER_BUCKETS];
+    int32_t m_fiberCount;
+    intptr_t m_trimGen;
+    int64_t m_recycled;
+
+    arena_chunk* m_chunkCache;
+    int32_t m_chunkCount;
+
+    static exlib::atomic s_freeze;
 };
 }
 
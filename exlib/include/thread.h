@@ -17,6 +17,7 @@
 #include <pthread.h>
 #include <semaphore.h>
 #include <unistd.h>
+#include <errno.h>
 #ifdef Darwin
 #include <mach/mach_init.h>
 #include <mach/task.h>
@@ -165,6 +166,11 @@ public:
         return WaitForSingleObject(m_sem, ms) == WAIT_OBJECT_0;
     }
 
+    bool TimedWaitUs(int64_t us)
+    {
+        return TimedWait((int32_t)((us + 999) / 1000));
+    }
+
     bool TryWait()
     {
         return TimedWait(0);
@@ -325,6 +331,11 @@ public:
         return dispatch_semaphore_wait(m_sem, ns) == 0;
     }
 
+    bool TimedWaitUs(int64_t us)
+    {
+        return dispatch_semaphore_wait(m_sem, dispatch_time(DISPATCH_TIME_NOW, us * NSEC_PER_USEC)) == 0;
+    }
+
     bool TryWait()
     {
         return dispatch_semaphore_wait(m_sem, DISPATCH_TIME_NOW) == 0;
@@ -333,6 +344,68 @@ public:
 public:
     dispatch_semaphore_t m_sem;
 };
+#elif defined(Linux)
+class OSSemaphore {
+public:
+    OSSemaphore(int32_t start_val = 0)
+        : m_count(start_val)
+        , m_waiters(0)
+        , m_spin(SPIN_MIN)
+    {
+    }
+
+    void Post()
+    {
+        atom_inc(&m_count);
+        if (m_waiters > 0)
+            wake();
+    }
+
+    void Wait()
+    {
+        if (!TrySpin())
+            WaitSlow(-1);
+    }
+
+    bool TryWait()
+    {
+        int32_t c = m_count;
+
+        while (c > 0) {
+            int32_t c1 = CompareAndSwap(&m_count, c, c - 1);
+            if (c1 == c)
+                return true;
+            c = c1;
+        }
+
+        return false;
+    }
+
+    bool TimedWait(int32_t ms)
+    {
+        return TimedWaitUs((int64_t)ms * 1000);
+    }
+
+    bool TimedWaitUs(int64_t us)
+    {
+        return TrySpin() || WaitSlow(us);
+    }
+
+private:
+    enum {
+        SPIN_MIN = 16,
+        SPIN_MAX = 1024
+    };
+
+    bool TrySpin();
+    bool WaitSlow(int64_t us);
+    void wake();
+
+private:
+    volatile int32_t m_count;
+    volatile int32_t m_waiters;
+    int32_t m_spin;
+};
 #else
 class OSSemaphore {
 public:
@@ -378,6 +451,22 @@ public:
         return sem_timedwait(&m_sem, &ts) == 0;
     }
 
+    bool TimedWaitUs(int64_t us)
+    {
+        struct timespec ts;
+        clock_gettime(CLOCK_REALTIME, &ts);
+
+        int64_t ns = ts.tv_nsec + (us % 1000000) * 1000;
+        ts.tv_sec += (time_t)(us / 1000000 + ns / 1000000000);
+        ts.tv_nsec = (long)(ns % 1000000000);
+
+        while (sem_timedwait(&m_sem, &ts))
+            if (errno != EINTR)
+                return false;
+
+        return true;
+    }
+
 public:
     sem_t m_sem;
 };
@@ -37,6 +37,10 @@ public:
         intptr_t Rsp;
         intptr_t sp;
     };
+    union {
+        intptr_t Rip;
+        intptr_t ip;
+    };
 };
 
 #pragma pack()
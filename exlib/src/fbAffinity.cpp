@@ -0,0 +1,157 @@
+/*
+ *  fbAffinity.cpp
+ *  Created on: Oct 17, 2026
+ *
+ *  Copyright (c) 2026 by Leo Hoo
+ *  lion@9465.net
+ */
+
+#include "osconfig.h"
+#include "service.h"
+
+#ifdef Linux
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#endif
+
+namespace exlib {
+
+#ifdef Linux
+
+#define MAX_NODES 64
+
+static int32_t s_nodes;
+static int32_t s_ncpus;
+static int32_t s_cpu[CPU_SETSIZE];
+static int32_t s_node[CPU_SETSIZE];
+static int32_t s_nodeFirst[MAX_NODES + 1];
+static cpu_set_t s_allowed;
+
+static bool read_cpulist(int32_t node, cpu_set_t& set)
+{
+    char path[128];
+    char buf[1024];
+    FILE* fp;
+    char* p;
+
+    snprintf(path, sizeof(path), "/sys/devices/system/node/node%d/cpulist", node);
+    if ((fp = fopen(path, "r")) == NULL)
+        return false;
+
+    p = fgets(buf, sizeof(buf), fp);
+    fclose(fp);
+
+    CPU_ZERO(&set);
+    while (p && *p >= '0' && *p <= '9') {
+        int32_t lo = (int32_t)strtol(p, &p, 10);
+        int32_t hi = lo;
+
+        if (*p == '-')
+            hi = (int32_t)strtol(p + 1, &p, 10);
+        if (*p == ',')
+            p++;
+
+        for (; lo <= hi && lo < CPU_SETSIZE; lo++)
+            CPU_SET(lo, &set);
+    }
+
+    return true;
+}
+
+static void load_topology()
+{
+    cpu_set_t allowed, set;
+    int32_t node, cpu;
+
+    if (s_nodes)
+        return;
+
+    if (sched_getaffinity(0, sizeof(allowed), &allowed) != 0) {
+        CPU_ZERO(&allowed);
+        CPU_SET(0, &allowed);
+    }
+    s_allowed = allowed;
+
+    for (node = 0; node < MAX_NODES && read_cpulist(node, set); node++) {
+        s_nodeFirst[s_nodes] = s_ncpus;
+        for (cpu = 0; cpu < CPU_SETSIZE; cpu++)
+            if (CPU_ISSET(cpu, &set) && CPU_ISSET(cpu, &allowed)) {
+                s_cpu[s_ncpus] = cpu;
+                s_node[s_ncpus++] = s_nodes;
+            }
+
+        if (s_nodeFirst[s_nodes] < s_ncpus)
+            s_nodes++;
+    }
+
+    if (s_ncpus == 0) {
+        for (cpu = 0; cpu < CPU_SETSIZE; cpu++)
+            if (CPU_ISSET(cpu, &allowed)) {
+                s_cpu[s_ncpus] = cpu;
+                s_node[s_ncpus++] = 0;
+            }
+        s_nodes = 1;
+    }
+
+    s_nodeFirst[s_nodes] = s_ncpus;
+}
+
+int32_t affinity_nodes()
+{
+    load_topology();
+    return s_nodes;
+}
+
+int32_t affinity_bind(int32_t idx, int32_t mode)
+{
+    cpu_set_t set;
+    int32_t node, i;
+
+    if (mode == Service::AFFINITY_NONE)
+        return 0;
+
+    load_topology();
+    CPU_ZERO(&set);
+
+    if (mode == Service::AFFINITY_CORE) {
+        i = idx % s_ncpus;
+        node = s_node[i];
+        CPU_SET(s_cpu[i], &set);
+    } else {
+        node = idx % s_nodes;
+        for (i = s_nodeFirst[node]; i < s_nodeFirst[node + 1]; i++)
+            CPU_SET(s_cpu[i], &set);
+    }
+
+    sched_setaffinity(0, sizeof(set), &set);
+    return node;
+}
+
+// threads inherit the mask of their creator, give a thread started by a
+// pinned worker back the cpus the process had before any worker was bound
+void affinity_unbind()
+{
+    if (s_nodes)
+        sched_setaffinity(0, sizeof(s_allowed), &s_allowed);
+}
+
+#else
+
+int32_t affinity_nodes()
+{
+    return 1;
+}
+
+int32_t affinity_bind(int32_t idx, int32_t mode)
+{
+    return 0;
+}
+
+void affinity_unbind()
+{
+}
+
+#endif
+}
@@ -0,0 +1,98 @@
+/*
+ *  fbArena.cpp
+ *  Created on: Oct 17, 2026
+ *
+ *  Copyright (c) 2026 by Leo Hoo
+ *  lion@9465.net
+ */
+
+#include <stdlib.h>
+#include "service.h"
+#include "arena.h"
+
+namespace exlib {
+
+arena_chunk* Arena::get_chunk(size_t sz)
+{
+    arena_chunk* chunk = NULL;
+
+    if (sz == CHUNK_SIZE) {
+        OSThread* thread_ = OSThread::current();
+
+        if (thread_ && thread_->is(Service::type))
+            chunk = ((Service*)thread_)->reuse_chunk();
+    }
+
+    if (chunk == NULL) {
+        chunk = (arena_chunk*)malloc(sizeof(arena_chunk) + sz);
+        chunk->m_size = sz;
+    }
+
+    return chunk;
+}
+
+void Arena::put_chunk(arena_chunk* chunk)
+{
+    if (chunk->m_size == CHUNK_SIZE) {
+        OSThread* thread_ = OSThread::current();
+
+        if (thread_ && thread_->is(Service::type) && ((Service*)thread_)->recycle_chunk(chunk))
+            return;
+    }
+
+    free(chunk);
+}
+
+void* Arena::grow(size_t sz, size_t align)
+{
+    size_t need = sz + align - 1;
+    arena_chunk* chunk = get_chunk(need > LARGE_SIZE ? need : CHUNK_SIZE);
+    intptr_t p = ((intptr_t)(chunk + 1) + (intptr_t)align - 1) & ~((intptr_t)align - 1);
+
+    chunk->m_next = m_chunk;
+    m_chunk = chunk;
+
+    // keep bumping the current chunk after a large block
+    if (chunk->m_size == CHUNK_SIZE) {
+        m_pos = p + sz;
+        m_end = (intptr_t)(chunk + 1) + CHUNK_SIZE;
+    }
+
+    return (void*)p;
+}
+
+void Arena::reset(const Mark& m)
+{
+    arena_chunk* chunk;
+
+    while ((chunk = m_chunk) != m.m_chunk) {
+        m_chunk = chunk->m_next;
+        put_chunk(chunk);
+    }
+
+    m_pos = m.m_pos;
+    m_end = m.m_end;
+}
+
+static void free_arena(void* p)
+{
+    delete (Arena*)p;
+}
+
+Arena* Arena::current()
+{
+    static int32_t s_key = Thread_base::tlsAlloc(free_arena);
+    Arena* arena;
+
+    if (Thread_base::current() == NULL)
+        return NULL;
+
+    arena = (Arena*)Thread_base::tlsGet(s_key);
+    if (arena == NULL) {
+        arena = new Arena();
+        Thread_base::tlsPut(s_key, arena);
+    }
+
+    return arena;
+}
+}
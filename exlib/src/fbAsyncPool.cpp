@@ -0,0 +1,175 @@
+/*
+ *  fbAsyncPool.cpp
+ *  Created on: Oct 17, 2026
+ *
+ *  Copyright (c) 2026 by Leo Hoo
+ *  lion@9465.net
+ */
+
+#include "service.h"
+#include "asyncpool.h"
+
+namespace exlib {
+
+int64_t timer_now();
+
+#define DEFAULT_THREADS 4
+
+class pool_task : public linkitem {
+public:
+    pool_task(void (*func)(void*), void* data, Fiber* fb)
+        : m_func(func)
+        , m_data(data)
+        , m_fb(fb)
+        , m_queued(0)
+    {
+    }
+
+public:
+    void (*m_func)(void*);
+    void* m_data;
+    Fiber* m_fb;
+    int64_t m_queued;
+};
+
+static spinlock s_lock;
+static List<pool_task> s_tasks;
+static OSSemaphore s_sem;
+
+static int32_t s_max = DEFAULT_THREADS;
+static exlib::atomic s_threads;
+static exlib::atomic s_idle;
+static exlib::atomic s_queued;
+static exlib::atomic s_maxQueued;
+static exlib::atomic s_running;
+
+static spinlock s_statsLock;
+static int64_t s_completed;
+static int64_t s_waitTime;
+
+class pool_thread : public OSThread {
+public:
+    virtual void Run()
+    {
+        pool_task* task;
+
+        while (true) {
+            s_idle.inc();
+            s_sem.Wait();
+            s_idle.dec();
+
+            s_lock.lock();
+            task = s_tasks.getHead();
+            s_lock.unlock();
+
+            if (task == NULL)
+                continue;
+
+            s_queued.dec();
+            s_running.inc();
+
+            int64_t wait = timer_now() - task->m_queued;
+            Fiber* fb = task->m_fb;
+
+            task->m_func(task->m_data);
+
+            s_running.dec();
+
+            s_statsLock.lock();
+            s_completed++;
+            s_waitTime += wait;
+            s_statsLock.unlock();
+
+            fb->resume();
+        }
+    }
+};
+
+static void grow()
+{
+    intptr_t n;
+
+    while ((n = s_threads) < s_max)
+        if (s_threads.CompareAndSwap(n, n + 1) == n) {
+            pool_thread* thread_ = new pool_thread();
+            thread_->start();
+            break;
+        }
+}
+
+void AsyncPool::init(int32_t threads)
+{
+    if (threads < 1)
+        threads = 1;
+
+    s_max = threads;
+}
+
+int32_t AsyncPool::size()
+{
+    return s_max;
+}
+
+void AsyncPool::run_blocking(void (*func)(void*), void* data)
+{
+    OSThread* thread_ = OSThread::current();
+
+    if (thread_ == NULL || !thread_->is(Service::type)) {
+        func(data);
+        return;
+    }
+
+    Fiber* fb = ((Service*)thread_)->running();
+    pool_task task(func, data, fb);
+
+    intptr_t q = s_queued.inc();
+    intptr_t m;
+
+    while (q > (m = s_maxQueued))
+        if (s_maxQueued.CompareAndSwap(m, q) == m)
+            break;
+
+    if (q > s_idle)
+        grow();
+
+    class cb : public Service::switchConextCallback {
+    public:
+        cb(pool_task* task)
+            : m_task(task)
+        {
+        }
+
+    public:
+        virtual void invoke()
+        {
+            m_task->m_queued = timer_now();
+
+            s_lock.lock();
+            s_tasks.putTail(m_task);
+            s_lock.unlock();
+
+            s_sem.Post();
+        }
+
+    private:
+        pool_task* m_task;
+    } _cb(&task);
+
+    fb->m_pService->switchConext(&_cb);
+}
+
+void AsyncPool::stats(Stats& s)
+{
+    s.threads = (int32_t)s_threads;
+    s.idle = (int32_t)s_idle;
+    s.maxThreads = s_max;
+    s.queued = s_queued;
+    s.maxQueued = s_maxQueued;
+    s.running = s_running;
+
+    s_statsLock.lock();
+    s.completed = s_completed;
+    s.waitTime = s_waitTime;
+    s_statsLock.unlock();
+}
+}
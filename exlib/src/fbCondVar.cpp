@@ -24,12 +24,36 @@ void CondVar::wait(Locker& l)
     l.lock();
 }
 
+bool CondVar::wait(Locker& l, int64_t us)
+{
+    if (us < 0) {
+        wait(l);
+        return true;
+    }
+
+    l.unlock();
+
+    Task_base* current = Thread_base::current();
+    assert(current != 0);
+
+    m_lock.lock();
+    m_blocks.putTail(current);
+    current->suspend(m_lock, m_blocks, us);
+
+    bool r = !current->m_timer.timeout();
+
+    l.lock();
+
+    return r;
+}
+
 void CondVar::notify_one()
 {
     Task_base* fb;
 
     m_lock.lock();
-    fb = m_blocks.getHead();
+    while ((fb = m_blocks.getHead()) != 0 && !fb->m_timer.claim())
+        ;
     m_lock.unlock();
 
     if (fb != 0)
@@ -39,12 +63,14 @@ void CondVar::notify_one()
 void CondVar::notify_all()
 {
     List<Task_base> blocks;
+    Task_base* fb;
 
     m_lock.lock();
-    m_blocks.getList(blocks);
+    while ((fb = m_blocks.getHead()) != 0)
+        if (fb->m_timer.claim())
+            blocks.putTail(fb);
     m_lock.unlock();
 
-    Task_base* fb;
     while ((fb = blocks.getHead()) != 0)
         fb->resume();
 }
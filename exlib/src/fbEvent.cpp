@@ -22,15 +22,40 @@ void Event::wait()
         m_lock.unlock();
 }
 
+bool Event::wait(int64_t us)
+{
+    if (us < 0) {
+        wait();
+        return true;
+    }
+
+    m_lock.lock();
+    if (m_set || us == 0) {
+        bool r = m_set;
+        m_lock.unlock();
+        return r;
+    }
+
+    Task_base* current = Thread_base::current();
+    assert(current != 0);
+
+    m_blocks.putTail(current);
+    current->suspend(m_lock, m_blocks, us);
+
+    return !current->m_timer.timeout();
+}
+
 void Event::pulse()
 {
     List<Task_base> blocks;
+    Task_base* fb;
 
     m_lock.lock();
-    m_blocks.getList(blocks);
+    while ((fb = m_blocks.getHead()) != 0)
+        if (fb->m_timer.claim())
+            blocks.putTail(fb);
     m_lock.unlock();
 
-    Task_base* fb;
     while ((fb = blocks.getHead()) != 0)
         fb->resume();
 }
@@ -38,13 +63,15 @@ void Event::pulse()
 void Event::set()
 {
     List<Task_base> blocks;
+    Task_base* fb;
 
     m_lock.lock();
     m_set = true;
-    m_blocks.getList(blocks);
+    while ((fb = m_blocks.getHead()) != 0)
+        if (fb->m_timer.claim())
+            blocks.putTail(fb);
     m_lock.unlock();
 
-    Task_base* fb;
     while ((fb = blocks.getHead()) != 0)
         fb->resume();
 }
@@ -16,8 +16,6 @@
 #include "service.h"
 #include "thread.h"
 
-#include <map>
-
 #ifndef WIN32
 #include <cxxabi.h>
 #include <dlfcn.h>
@@ -25,34 +23,6 @@
 
 namespace exlib {
 
-class Sleeping : public linkitem,
-                 public Service::switchConextCallback {
-public:
-    Sleeping(Task_base* now, int32_t tm)
-        : m_now(now)
-        , m_tm(tm)
-    {
-    }
-
-public:
-    virtual void invoke();
-
-public:
-    Task_base* m_now;
-    int32_t m_tm;
-};
-
-class Canceling : public linkitem {
-public:
-    Canceling(Task_base* now)
-        : m_now(now)
-    {
-    }
-
-public:
-    Task_base* m_now;
-};
-
 Fiber* Fiber::current()
 {
     Service* pService = Service::current();
@@ -63,10 +33,18 @@ Fiber* Fiber::current()
     return NULL;
 }
 
+void fiber_destroyed();
+
 void Fiber::destroy()
 {
+    OSThread* thread_ = OSThread::current();
+
+    fiber_destroyed();
     Thread_base::destroy();
 
+    if (thread_ && thread_->is(Service::type) && ((Service*)thread_)->recycle(this))
+        return;
+
     delete_fiber(m_ctx);
     delete this;
 }
@@ -120,7 +98,7 @@ void Fiber::yield()
     public:
         virtual void invoke()
         {
-            m_fb->m_pService->post(m_fb);
+            m_fb->m_pService->post(m_fb, true);
         }
 
     private:
@@ -130,100 +108,372 @@ void Fiber::yield()
     m_pService->switchConext(&_cb);
 }
 
-static class _timerThread : public OSThread {
+void timer_kick(Service* poller);
+bool reactor_active();
+
+#define TIMER_TICK 100
+
+#define TVR_BITS 8
+#define TVN_BITS 6
+#define TVR_SIZE (1 << TVR_BITS)
+#define TVN_SIZE (1 << TVN_BITS)
+#define TVR_MASK (TVR_SIZE - 1)
+#define TVN_MASK (TVN_SIZE - 1)
+#define TVN_LEVELS 4
+
+static int64_t now_us()
+{
+    return (int64_t)std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+}
+
+static class _timerWheel {
+public:
+    _timerWheel()
+        : m_tick(0)
+        , m_next(INT64_MAX)
+        , m_count(0)
+        , m_wait(0)
+        , m_poller(NULL)
+    {
+    }
+
 public:
-    void wait()
+    void post(Task_base* now, int64_t us)
+    {
+        TimerNode* node = &now->m_timer;
+        int64_t t = now_us();
+        Service* poller;
+        bool kick;
+
+        node->m_expire = (t + us + TIMER_TICK - 1) / TIMER_TICK;
+
+        m_lock.lock();
+
+        assert(node->m_slot == NULL);
+
+        if (m_count == 0 && m_tick < t / TIMER_TICK)
+            m_tick = t / TIMER_TICK;
+
+        add(node);
+        m_count++;
+
+        if (node->m_expire < m_next)
+            m_next = node->m_expire;
+
+        kick = m_wait == 0 || node->m_expire < m_wait;
+        poller = m_poller;
+
+        m_lock.unlock();
+
+        if (kick)
+            timer_kick(poller);
+    }
+
+    void remove(TimerNode* node)
+    {
+        m_lock.lock();
+        if (node->m_slot) {
+            ((List<TimerNode>*)node->m_slot)->remove(node);
+            node->m_slot = NULL;
+            m_count--;
+        }
+        m_lock.unlock();
+    }
+
+    void cancel(Task_base* now)
     {
-        std::multimap<double, Sleeping*>::iterator e;
+        TimerNode* node = &now->m_timer;
+        bool found = false;
+
+        m_lock.lock();
+        if (node->m_slot && expire(node)) {
+            ((List<TimerNode>*)node->m_slot)->remove(node);
+            node->m_slot = NULL;
+            m_count--;
+            found = true;
+        }
+        m_lock.unlock();
 
-        e = m_tms.begin();
-        if (e != m_tms.end())
-            m_sem.TimedWait((int32_t)(e->first - m_tm));
-        else
-            m_sem.Wait();
+        if (found)
+            fire(node);
     }
 
-    virtual void Run()
+    bool process(Service* poller, int64_t& wait, int64_t& t)
     {
-        while (1) {
-            Sleeping* p;
-            Canceling* p1;
-            std::multimap<double, Sleeping*>::iterator e;
+        t = now_us();
+        int64_t tick = t / TIMER_TICK;
+        List<TimerNode> expired;
+        bool granted = false;
+
+        if (poller == NULL && (m_count == 0 || tick < m_next))
+            return false;
+
+        m_lock.lock();
+
+        run(tick, expired);
+
+        if (m_count == 0) {
+            m_next = INT64_MAX;
+            wait = -1;
+        } else {
+            m_next = next_expire();
+            wait = m_next * TIMER_TICK - t;
+            if (wait < 0)
+                wait = 0;
+        }
 
-            wait();
+        if (poller && (m_poller == NULL || m_poller == poller)) {
+            m_poller = poller;
+            m_wait = m_next;
+            granted = true;
+        }
 
-            m_tm = (double)std::chrono::duration_cast<std::chrono::milliseconds>(
-                std::chrono::system_clock::now().time_since_epoch())
-                       .count();
+        m_lock.unlock();
 
-            while ((p = m_acSleep.getHead()) != NULL) {
-                m_tms.insert(std::make_pair(m_tm + p->m_tm, p));
-            }
+        TimerNode* node;
+        while ((node = expired.getHead()) != NULL)
+            fire(node);
 
-            while ((p1 = m_acCancel.getHead()) != NULL) {
-                e = m_tms.begin();
-                while (e != m_tms.end()) {
-                    if (e->second->m_now == p1->m_now) {
-                        e->second->m_now->resume();
-                        delete e->second;
-                        m_tms.erase(e);
-                        break;
-                    }
-
-                    e++;
-                }
+        return granted;
+    }
 
-                delete p1;
-            }
+    intptr_t count() const
+    {
+        return m_count;
+    }
 
-            while (1) {
-                e = m_tms.begin();
-                if (e == m_tms.end())
-                    break;
-                if (e->first > m_tm)
+    void kick()
+    {
+        m_lock.lock();
+        Service* poller = m_poller;
+        m_lock.unlock();
+
+        timer_kick(poller);
+    }
+
+    // the leaving poller hands over while timers or armed fds are left,
+    // Reactor waits only kick a poller when the first fd is armed
+    bool unpoll(Service* poller)
+    {
+        bool pending = false;
+
+        m_lock.lock();
+        if (m_poller == poller) {
+            m_poller = NULL;
+            m_wait = 0;
+            pending = m_count > 0 || reactor_active();
+        }
+        m_lock.unlock();
+
+        return pending;
+    }
+
+private:
+    void fire(TimerNode* node)
+    {
+        if (node->m_blocks) {
+            node->m_lock->lock();
+            if (node->m_blocks->linked(node->m_task))
+                node->m_blocks->remove(node->m_task);
+            node->m_lock->unlock();
+        }
+
+        node->m_task->resume();
+    }
+
+    bool expire(TimerNode* node)
+    {
+        return node->m_state == TimerNode::IDLE
+            || node->m_state.CompareAndSwap(TimerNode::WAIT, TimerNode::TIMEOUT) == TimerNode::WAIT;
+    }
+
+    void add(TimerNode* node)
+    {
+        int64_t expire = node->m_expire;
+        int64_t idx = expire - m_tick;
+        List<TimerNode>* slot;
+
+        if (idx < 0)
+            slot = &m_tv1[m_tick & TVR_MASK];
+        else if (idx < TVR_SIZE)
+            slot = &m_tv1[expire & TVR_MASK];
+        else {
+            int32_t level;
+
+            for (level = 0; level < TVN_LEVELS - 1; level++)
+                if (idx < ((int64_t)1 << (TVR_BITS + (level + 1) * TVN_BITS)))
                     break;
 
-                e->second->m_now->resume();
-                delete e->second;
-                m_tms.erase(e);
+            if (level == TVN_LEVELS - 1) {
+                int64_t max = ((int64_t)1 << (TVR_BITS + TVN_LEVELS * TVN_BITS)) - 1;
+                if (idx > max)
+                    expire = m_tick + max;
             }
+
+            slot = &m_tvn[level][(expire >> (TVR_BITS + level * TVN_BITS)) & TVN_MASK];
         }
+
+        slot->putTail(node);
+        node->m_slot = slot;
     }
 
-    void post(Task_base* now, int32_t ms)
+    int32_t cascade(int32_t level)
     {
-        m_acSleep.putTail(new Sleeping(now, ms));
-        m_sem.Post();
+        int32_t idx = (int32_t)((m_tick >> (TVR_BITS + level * TVN_BITS)) & TVN_MASK);
+        List<TimerNode> list;
+        TimerNode* node;
+
+        m_tvn[level][idx].getList(list);
+        while ((node = list.getHead()) != NULL)
+            add(node);
+
+        return idx;
     }
 
-    void cancel(Task_base* now)
+    void run(int64_t tick, List<TimerNode>& expired)
     {
-        m_acCancel.putTail(new Canceling(now));
-        m_sem.Post();
+        while (m_count > 0 && m_tick <= tick) {
+            int32_t idx = (int32_t)(m_tick & TVR_MASK);
+            int32_t level = 0;
+            TimerNode* node;
+
+            if (idx == 0)
+                while (level < TVN_LEVELS && cascade(level) == 0)
+                    level++;
+
+            while ((node = m_tv1[idx].getHead()) != NULL) {
+                node->m_slot = NULL;
+                m_count--;
+                if (expire(node))
+                    expired.putTail(node);
+            }
+
+            m_tick++;
+        }
+
+        if (m_count == 0 && m_tick <= tick)
+            m_tick = tick + 1;
     }
 
-private:
-    OSSemaphore m_sem;
-    double m_tm;
-    LockedList<Sleeping> m_acSleep;
-    LockedList<Canceling> m_acCancel;
-    std::multimap<double, Sleeping*> m_tms;
+    int64_t next_expire()
+    {
+        int32_t i;
+
+        for (i = 0; i < TVR_SIZE; i++) {
+            int64_t t = m_tick + i;
+
+            if ((t & TVR_MASK) == 0)
+                return t;
 
-    friend class Sleeping;
+            if (!m_tv1[t & TVR_MASK].empty())
+                return t;
+        }
+
+        return m_tick + TVR_SIZE;
+    }
+
+private:
+    spinlock m_lock;
+    int64_t m_tick;
+    volatile int64_t m_next;
+    volatile intptr_t m_count;
+    int64_t m_wait;
+    Service* m_poller;
+    List<TimerNode> m_tv1[TVR_SIZE];
+    List<TimerNode> m_tvn[TVN_LEVELS][TVN_SIZE];
 } s_timer;
 
-void Sleeping::invoke()
+bool TimerNode::claim()
 {
-    s_timer.m_acSleep.putTail(this);
-    s_timer.m_sem.Post();
+    if (m_state == IDLE)
+        return true;
+
+    if (m_state.CompareAndSwap(WAIT, SIGNALED) != WAIT)
+        return false;
+
+    s_timer.remove(this);
+    return true;
 }
 
-void init_timer()
+void Task_base::suspend(spinlock& lock, List<Task_base>& blocks, int64_t us)
 {
-    s_timer.start();
+    m_timer.m_lock = &lock;
+    m_timer.m_blocks = &blocks;
+    m_timer.m_state = TimerNode::WAIT;
+    s_timer.post(this, us);
+    suspend(lock);
+}
+
+void Fiber::suspend(spinlock& lock, List<Task_base>& blocks, int64_t us)
+{
+    class cb : public Service::switchConextCallback {
+    public:
+        cb(Fiber* fb, spinlock& lock, int64_t us)
+            : m_fb(fb)
+            , m_lock(lock)
+            , m_us(us)
+        {
+        }
+
+    public:
+        virtual void invoke()
+        {
+            spinlock& lock = m_lock;
+
+            s_timer.post(m_fb, m_us);
+            lock.unlock();
+        }
+
+    private:
+        Fiber* m_fb;
+        spinlock& m_lock;
+        int64_t m_us;
+    } _cb(this, lock, us);
+
+    m_timer.m_lock = &lock;
+    m_timer.m_blocks = &blocks;
+    m_timer.m_state = TimerNode::WAIT;
+    m_pService->switchConext(&_cb);
+}
+
+bool timer_process(Service* poller, int64_t& wait, int64_t& now)
+{
+    return s_timer.process(poller, wait, now);
+}
+
+int64_t timer_now()
+{
+    return now_us();
+}
+
+intptr_t timer_count()
+{
+    return s_timer.count();
+}
+
+void timer_kick_poller()
+{
+    s_timer.kick();
+}
+
+bool timer_unpoll(Service* poller)
+{
+    return s_timer.unpoll(poller);
+}
+
+void Fiber::set_deadline(int64_t us)
+{
+    m_deadline = us > 0 ? now_us() + us : 0;
 }
 
 void Fiber::sleep(int32_t ms, Task_base* now)
+{
+    usleep((int64_t)ms * 1000, now);
+}
+
+void Fiber::usleep(int64_t us, Task_base* now)
 {
     if (now == 0)
         now = current();
@@ -231,22 +481,41 @@ void Fiber::sleep(int32_t ms, Task_base* now)
     assert(now != 0);
 
     if (now->is(Fiber::type)) {
-        if (ms <= 0)
+        if (us <= 0)
             ((Fiber*)now)->yield();
         else {
-            ((Fiber*)now)->m_pService->switchConext(new Sleeping(now, ms));
+            class cb : public Service::switchConextCallback {
+            public:
+                cb(Task_base* now, int64_t us)
+                    : m_now(now)
+                    , m_us(us)
+                {
+                }
+
+            public:
+                virtual void invoke()
+                {
+                    s_timer.post(m_now, m_us);
+                }
+
+            private:
+                Task_base* m_now;
+                int64_t m_us;
+            } _cb(now, us);
+
+            ((Fiber*)now)->m_pService->switchConext(&_cb);
         }
     } else if (now->is(OSThread::type)) {
-        if (ms <= 0)
-            ms = 0;
+        if (us <= 0)
+            us = 0;
 
-        s_timer.post(now, ms);
+        s_timer.post(now, us);
         now->suspend();
     } else {
-        if (ms <= 0)
-            ms = 0;
+        if (us <= 0)
+            us = 0;
 
-        s_timer.post(now, ms);
+        s_timer.post(now, us);
     }
 }
 
@@ -7,7 +7,6 @@
  */
 
 #include "service.h"
-#include <map>
 
 #ifndef WIN32
 #include <unistd.h>
@@ -15,6 +14,70 @@
 
 namespace exlib {
 
+static Service* running_on(Task_base* current)
+{
+    OSThread* thread_ = OSThread::current();
+
+    if (thread_ && thread_->is(Service::type) && ((Service*)thread_)->running() == current)
+        return (Service*)thread_;
+
+    return NULL;
+}
+
+void Locker::acquire(Task_base* current)
+{
+    m_locker = current;
+    m_service = running_on(current);
+    m_stats.acquired++;
+}
+
+bool Locker::spin(Task_base* current)
+{
+    if (Service::cpus() < 2)
+        return false;
+
+    int32_t limit = m_spin * 2;
+    int32_t i;
+
+    if (limit > SPIN_MAX)
+        limit = SPIN_MAX;
+
+    for (i = 0; i < limit; i++) {
+        Task_base* owner = *(Task_base* volatile*)&m_locker;
+
+        if (owner == 0) {
+            m_lock.lock();
+            if (m_locker == 0) {
+                m_count = 1;
+                acquire(current);
+                m_stats.spun++;
+
+                m_spin += (i - m_spin) / 8;
+                if (m_spin < SPIN_MIN)
+                    m_spin = SPIN_MIN;
+
+                m_lock.unlock();
+                return true;
+            }
+            m_lock.unlock();
+        } else {
+            Service* svc = *(Service* volatile*)&m_service;
+            if (svc == 0 || svc->running() != owner)
+                break;
+        }
+
+        yield();
+    }
+
+    if (i == limit) {
+        m_spin += (limit - m_spin) / 8;
+        if (m_spin > SPIN_MAX / 2)
+            m_spin = SPIN_MAX / 2;
+    }
+
+    return false;
+}
+
 bool Locker::lock(Task_base* current)
 {
     if (current == 0)
@@ -31,15 +94,80 @@ bool Locker::lock(Task_base* current)
     }
 
     if (m_locker && current != m_locker) {
-        m_blocks.putTail(current);
-        current->suspend(m_lock);
-        return false;
+        m_stats.contended++;
+        m_lock.unlock();
+
+        if (spin(current))
+            return true;
+
+        m_lock.lock();
+        if (m_locker) {
+            m_stats.parked++;
+            m_blocks.putTail(current);
+            current->suspend(m_lock);
+
+            m_service = running_on(current);
+            return false;
+        }
+    }
+
+    if (++m_count == 1)
+        acquire(current);
+
+    m_lock.unlock();
+
+    return true;
+}
+
+bool Locker::timedlock(int64_t us, Task_base* current)
+{
+    if (us < 0) {
+        lock(current);
+        return true;
+    }
+
+    if (current == 0)
+        current = Thread_base::current();
+
+    assert(current != 0);
+    assert(m_recursive || current != m_locker);
+
+    m_lock.lock();
+
+    if (!m_recursive && current == m_locker) {
+        m_lock.unlock();
+        return true;
     }
 
-    if (++m_count == 1) {
-        m_locker = current;
+    if (m_locker && current != m_locker) {
+        if (us == 0) {
+            m_lock.unlock();
+            return false;
+        }
+
+        m_stats.contended++;
+        m_lock.unlock();
+
+        if (spin(current))
+            return true;
+
+        m_lock.lock();
+        if (m_locker) {
+            m_stats.parked++;
+            m_blocks.putTail(current);
+            current->suspend(m_lock, m_blocks, us);
+
+            if (current->m_timer.timeout())
+                return false;
+
+            m_service = running_on(current);
+            return true;
+        }
     }
 
+    if (++m_count == 1)
+        acquire(current);
+
     m_lock.unlock();
 
     return true;
@@ -65,9 +193,8 @@ bool Locker::trylock(Task_base* current)
         return false;
     }
 
-    if (++m_count == 1) {
-        m_locker = current;
-    }
+    if (++m_count == 1)
+        acquire(current);
 
     m_lock.unlock();
 
@@ -91,9 +218,14 @@ void Locker::unlock(Task_base* current)
     m_lock.lock();
 
     if (--m_count == 0) {
-        if ((m_locker = m_blocks.getHead()) != 0) {
+        while ((m_locker = m_blocks.getHead()) != 0 && !m_locker->m_timer.claim())
+            ;
+
+        m_service = NULL;
+        if (m_locker != 0) {
             fb = m_locker;
             m_count = 1;
+            m_stats.handoffs++;
         }
     }
 
@@ -0,0 +1,605 @@
+/*
+ *  fbProfiler.cpp
+ *  Created on: Oct 17, 2026
+ *
+ *  Copyright (c) 2026 by Leo Hoo
+ *  lion@9465.net
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <map>
+#include <set>
+#include <vector>
+
+#include "osconfig.h"
+#include "service.h"
+#include "profiler.h"
+
+#ifndef _WIN32
+#include <unwind.h>
+#include <dlfcn.h>
+#include <cxxabi.h>
+#include <signal.h>
+#endif
+
+#ifdef Linux
+#include <ucontext.h>
+#endif
+
+namespace exlib {
+
+#define MAX_FRAMES 64
+#define RING_SIZE 128
+#define MAX_RINGS 256
+
+// pseudo frames for fibers that have no stack worth walking
+#define FRAME_RUNNING 1
+#define FRAME_NOT_STARTED 2
+#define FRAME_NOT_WALKED 3
+
+typedef std::map<std::string, int64_t> stack_map;
+
+static spinlock s_lock;
+static stack_map s_stacks;
+static int64_t s_samples;
+
+static void add_stack(stack_map& stacks, const char* name, intptr_t* frames, int32_t count)
+{
+    std::string key(name, strnlen(name, 16));
+
+    key.append(1, '\0');
+    key.append((const char*)frames, count * sizeof(intptr_t));
+
+    stacks[key]++;
+}
+
+static void append_frame(std::string& out, intptr_t pc, std::map<intptr_t, std::string>& cache)
+{
+    if (pc == FRAME_RUNNING) {
+        out.append("[running]");
+        return;
+    }
+
+    if (pc == FRAME_NOT_STARTED) {
+        out.append("[not started]");
+        return;
+    }
+
+    if (pc == FRAME_NOT_WALKED) {
+        out.append("[stack not walked]");
+        return;
+    }
+
+    std::map<intptr_t, std::string>::iterator it = cache.find(pc);
+    if (it != cache.end()) {
+        out.append(it->second);
+        return;
+    }
+
+    char buf[64];
+    std::string sym;
+
+#ifndef _WIN32
+    Dl_info info;
+
+    if (dladdr((void*)pc, &info)) {
+        if (info.dli_sname) {
+            int32_t status = 0;
+            char* name = abi::__cxa_demangle(info.dli_sname, NULL, NULL, &status);
+
+            sym = name ? name : info.dli_sname;
+            free(name);
+        } else if (info.dli_fname) {
+            const char* base = strrchr(info.dli_fname, '/');
+
+            snprintf(buf, sizeof(buf), "+0x%lx", (unsigned long)(pc - (intptr_t)info.dli_fbase));
+            sym = base ? base + 1 : info.dli_fname;
+            sym.append(buf);
+        }
+    }
+#endif
+
+    if (sym.empty()) {
+        snprintf(buf, sizeof(buf), "0x%lx", (unsigned long)pc);
+        sym = buf;
+    }
+
+    cache[pc] = sym;
+    out.append(sym);
+}
+
+static void render(stack_map& stacks, std::string& out)
+{
+    std::map<intptr_t, std::string> cache;
+    stack_map lines;
+    stack_map::iterator it;
+    char buf[32];
+
+    // different pcs inside one function fold into the same line
+    for (it = stacks.begin(); it != stacks.end(); ++it) {
+        const std::string& key = it->first;
+        size_t len = strlen(key.c_str());
+        const intptr_t* frames = (const intptr_t*)(key.data() + len + 1);
+        int32_t count = (int32_t)((key.length() - len - 1) / sizeof(intptr_t));
+        std::string line(len ? key.c_str() : "fiber", len ? len : 5);
+        intptr_t frame;
+
+        // frames are stored leaf first
+        while (count-- > 0) {
+            memcpy(&frame, frames + count, sizeof(frame));
+            line.append(1, ';');
+            append_frame(line, frame, cache);
+        }
+
+        lines[line] += it->second;
+    }
+
+    for (it = lines.begin(); it != lines.end(); ++it) {
+        snprintf(buf, sizeof(buf), " %lld\n", (long long)it->second);
+        out.append(it->first);
+        out.append(buf);
+    }
+}
+
+#ifndef _WIN32
+
+class unwind_state {
+public:
+    unwind_state(intptr_t* frames)
+        : m_frames(frames)
+        , m_count(0)
+    {
+    }
+
+public:
+    intptr_t* m_frames;
+    int32_t m_count;
+};
+
+static _Unwind_Reason_Code unwind_one(struct _Unwind_Context* ctx, void* arg)
+{
+    unwind_state* st = (unwind_state*)arg;
+    int before = 0;
+    intptr_t ip = (intptr_t)_Unwind_GetIPInfo(ctx, &before);
+
+    if (ip == 0 || st->m_count >= MAX_FRAMES)
+        return _URC_END_OF_STACK;
+
+    // return addresses point past the call, step back into it
+    if (!before)
+        ip--;
+
+    st->m_frames[st->m_count++] = ip;
+    return _URC_NO_REASON;
+}
+
+#if defined(Linux) || defined(arm64)
+
+// follows the frame records from fp up to the top of the fiber's stack,
+// reading nothing outside [sp, hi)
+static int32_t follow_frames(intptr_t fp, intptr_t sp, intptr_t hi, intptr_t* frames, int32_t count)
+{
+    while (count < MAX_FRAMES && fp >= sp && fp <= hi - 2 * (intptr_t)sizeof(intptr_t)
+        && (fp & (sizeof(intptr_t) - 1)) == 0) {
+        intptr_t* rec = (intptr_t*)fp;
+
+        if (rec[1] == 0)
+            break;
+
+        // return addresses point past the call, step back into it
+        frames[count++] = rec[1] - 1;
+
+        if (rec[0] <= fp)
+            break;
+        fp = rec[0];
+    }
+
+    return count;
+}
+
+#endif
+
+#endif
+
+#ifdef Linux
+
+class prof_sample {
+public:
+    char m_name[16];
+    int32_t m_count;
+    intptr_t m_frames[MAX_FRAMES];
+};
+
+class prof_ring {
+public:
+    prof_sample m_samples[RING_SIZE];
+    exlib::atomic m_head;
+    exlib::atomic m_tail;
+};
+
+static prof_ring* s_rings[MAX_RINGS];
+static int32_t s_interval;
+static exlib::atomic s_active;
+static exlib::atomic s_dropped;
+static OSSemaphore s_wake;
+static bool s_started;
+
+static void drain()
+{
+    int32_t i;
+
+    for (i = 0; i < MAX_RINGS && s_rings[i]; i++) {
+        prof_ring* ring = s_rings[i];
+        intptr_t tail = ring->m_tail;
+
+        while (tail < ring->m_head) {
+            prof_sample& s = ring->m_samples[tail % RING_SIZE];
+
+            add_stack(s_stacks, s.m_name, s.m_frames, s.m_count);
+            s_samples++;
+            tail++;
+        }
+
+        ring->m_tail = tail;
+    }
+}
+
+class prof_sampler : public OSThread {
+public:
+    virtual void Run()
+    {
+        while (true) {
+            if (!s_active) {
+                s_wake.Wait();
+                continue;
+            }
+
+            ::usleep(s_interval);
+            Profiler::kick();
+
+            s_lock.lock();
+            drain();
+            s_lock.unlock();
+        }
+    }
+};
+
+// the DWARF unwinder is not async-signal-safe, it takes the loader lock
+// and libgcc's object mutex and would deadlock on a worker interrupted
+// inside dlopen, dladdr or another unwind. the handler only follows the
+// frame pointer chain from the interrupted context, reading nothing
+// outside the fiber's own stack.
+static int32_t walk_frames(ucontext_t* uc, Fiber* fb, intptr_t* frames)
+{
+    intptr_t hi = (intptr_t)fb->m_ctx;
+    intptr_t lo = hi - fb->m_stacksize;
+    intptr_t pc, fp, sp;
+    int32_t count = 0;
+
+#if defined(amd64)
+    pc = uc->uc_mcontext.gregs[REG_RIP];
+    fp = uc->uc_mcontext.gregs[REG_RBP];
+    sp = uc->uc_mcontext.gregs[REG_RSP];
+#elif defined(i386)
+    pc = uc->uc_mcontext.gregs[REG_EIP];
+    fp = uc->uc_mcontext.gregs[REG_EBP];
+    sp = uc->uc_mcontext.gregs[REG_ESP];
+#elif defined(arm64)
+    pc = uc->uc_mcontext.pc;
+    fp = uc->uc_mcontext.regs[29];
+    sp = uc->uc_mcontext.sp;
+#else
+    return 0;
+#endif
+
+    frames[count++] = pc;
+
+    // interrupted on the worker's own stack, between switches
+    if (sp < lo || sp >= hi)
+        return count;
+
+    return follow_frames(fp, sp, hi, frames, count);
+}
+
+void Profiler::on_signal(int32_t sig, void* info, void* context)
+{
+    OSThread* thread_ = OSThread::current();
+    int32_t err = errno;
+
+    if (thread_ && thread_->is(Service::type))
+        sample((Service*)thread_, context);
+
+    errno = err;
+}
+
+void Profiler::sample(Service* worker, void* context)
+{
+    prof_ring* ring;
+
+    if (!worker->m_inFiber || worker->m_index >= MAX_RINGS || (ring = s_rings[worker->m_index]) == NULL)
+        return;
+
+    intptr_t head = ring->m_head;
+
+    if (head - ring->m_tail >= RING_SIZE) {
+        s_dropped.inc();
+        return;
+    }
+
+    prof_sample& s = ring->m_samples[head % RING_SIZE];
+    Fiber* fb = worker->m_running;
+
+    memcpy(s.m_name, fb->name_, sizeof(s.m_name));
+    s.m_count = walk_frames((ucontext_t*)context, fb, s.m_frames);
+
+    ring->m_head = head + 1;
+}
+
+void Profiler::kick()
+{
+    Service* master = Service::master();
+    int32_t cnt = (int32_t)master->m_poolSize;
+    int32_t i;
+
+    for (i = 0; i < cnt && i < MAX_RINGS; i++) {
+        Service* worker = master->m_pool[i];
+
+        if (s_rings[i] == NULL)
+            s_rings[i] = new prof_ring();
+
+        if (worker && worker->m_inFiber)
+            pthread_kill(worker->thread_, SIGPROF);
+    }
+}
+
+bool Profiler::start(int32_t interval_us)
+{
+    struct sigaction sa;
+
+    if (Service::master() == NULL)
+        return false;
+
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_sigaction = (void (*)(int, siginfo_t*, void*))on_signal;
+    sa.sa_flags = SA_RESTART | SA_SIGINFO;
+    sigemptyset(&sa.sa_mask);
+    sigaction(SIGPROF, &sa, NULL);
+
+    s_interval = interval_us > 100 ? interval_us : 100;
+
+    if (!s_started) {
+        s_started = true;
+        (new prof_sampler())->start();
+    }
+
+    if (s_active.xchg(1) == 0)
+        s_wake.Post();
+
+    return true;
+}
+
+void Profiler::stop()
+{
+    s_active = 0;
+}
+
+int64_t Profiler::samples()
+{
+    int64_t n;
+
+    s_lock.lock();
+    drain();
+    n = s_samples;
+    s_lock.unlock();
+
+    return n;
+}
+
+#else
+
+void Profiler::on_signal(int32_t sig, void* info, void* context)
+{
+}
+
+void Profiler::sample(Service* worker, void* context)
+{
+}
+
+void Profiler::kick()
+{
+}
+
+bool Profiler::start(int32_t interval_us)
+{
+    return false;
+}
+
+void Profiler::stop()
+{
+}
+
+int64_t Profiler::samples()
+{
+    return s_samples;
+}
+
+static void drain()
+{
+}
+
+#endif
+
+void Profiler::reset()
+{
+    s_lock.lock();
+    drain();
+    s_stacks.clear();
+    s_samples = 0;
+    s_lock.unlock();
+}
+
+void Profiler::folded(std::string& out)
+{
+    stack_map stacks;
+
+    s_lock.lock();
+    drain();
+    stacks = s_stacks;
+    s_lock.unlock();
+
+    render(stacks, out);
+}
+
+class snap_state {
+public:
+    std::set<Fiber*> m_running;
+    std::vector<Fiber*> m_fibers;
+    stack_map m_stacks;
+};
+
+#if defined(amd64) && !defined(_WIN32)
+
+extern "C" void nix_start();
+
+static intptr_t s_snapFrames[MAX_FRAMES];
+static int32_t s_snapCount;
+
+// entered through switch_fiber as if it had been called at the suspended
+// fiber's resume address, so the unwinder continues into the fiber's frames
+static void __attribute__((noinline)) unwind_entry(void* from, void* to)
+{
+    unwind_state st(s_snapFrames);
+    registers scratch;
+
+    _Unwind_Backtrace(unwind_one, &st);
+    s_snapCount = st.m_count;
+
+    switch_fiber(&scratch, from);
+}
+
+static int32_t walk_fiber(Fiber* fb, intptr_t* frames)
+{
+    registers* saved = (registers*)fb->m_ctx;
+    registers back, ctx;
+    intptr_t* sp;
+
+    if (saved->Rip == (intptr_t)nix_start) {
+        frames[0] = FRAME_NOT_STARTED;
+        return 1;
+    }
+
+    // the slot below the saved sp held the return address of the switch,
+    // put it back so the fiber's stack looks like a call in progress
+    sp = (intptr_t*)saved->Rsp - 1;
+    *sp = saved->Rip;
+
+    ctx = *saved;
+    ctx.Rsp = (intptr_t)sp;
+    ctx.Rip = (intptr_t)unwind_entry;
+
+    s_snapCount = 0;
+    switch_fiber(&back, &ctx);
+
+    // skip unwind_entry itself
+    if (s_snapCount <= 1)
+        return 0;
+
+    memcpy(frames, s_snapFrames + 1, (s_snapCount - 1) * sizeof(intptr_t));
+    return s_snapCount - 1;
+}
+
+#elif defined(arm64) && !defined(_WIN32)
+
+extern "C" void nix_start();
+
+// nix_switch saved x29 and x30 of the suspended fiber, x30 returns into
+// the function that switched away and x29 heads its frame record chain
+static int32_t walk_fiber(Fiber* fb, intptr_t* frames)
+{
+    registers* saved = (registers*)fb->m_ctx;
+    intptr_t hi = (intptr_t)fb->m_ctx;
+
+    if (saved->lr == (intptr_t)nix_start) {
+        frames[0] = FRAME_NOT_STARTED;
+        return 1;
+    }
+
+    frames[0] = saved->lr - 1;
+    return follow_frames(saved->fp, saved->sp, hi, frames, 1);
+}
+
+#else
+
+static int32_t walk_fiber(Fiber* fb, intptr_t* frames)
+{
+    frames[0] = FRAME_NOT_WALKED;
+    return 1;
+}
+
+#endif
+
+// only take a reference under the shard lock, the walk happens after
+static void grab_fiber(Fiber* fb, void* data)
+{
+    snap_state* st = (snap_state*)data;
+
+    fb->Ref();
+    st->m_fibers.push_back(fb);
+}
+
+static void snap_fiber(Fiber* fb, snap_state* st)
+{
+    intptr_t frames[MAX_FRAMES];
+    int32_t count;
+
+    if (st->m_running.count(fb)) {
+        frames[0] = FRAME_RUNNING;
+        count = 1;
+    } else
+        count = walk_fiber(fb, frames);
+
+    add_stack(st->m_stacks, fb->name_, frames, count);
+}
+
+void Profiler::fibers(std::string& out)
+{
+    static spinlock s_snapLock;
+    Service* master = Service::master();
+    snap_state st;
+    int32_t cnt, i;
+
+    if (master == NULL)
+        return;
+
+    Service::forEach(grab_fiber, &st);
+
+    s_snapLock.lock();
+
+    // workers that have not entered a fiber yet will wait for s_freeze to
+    // clear, the ones already inside keep running and are reported as such
+    Service::s_freeze = 1;
+
+    cnt = (int32_t)master->m_poolSize;
+    for (i = 0; i < cnt; i++) {
+        Service* worker = master->m_pool[i];
+
+        if (worker && worker->m_inFiber)
+            st.m_running.insert(worker->m_running);
+    }
+
+    // a fiber that exited since it was grabbed is still walked, its stack
+    // stays mapped until the last reference goes
+    for (i = 0; i < (int32_t)st.m_fibers.size(); i++)
+        snap_fiber(st.m_fibers[i], &st);
+
+    Service::thaw();
+    s_snapLock.unlock();
+
+    for (i = 0; i < (int32_t)st.m_fibers.size(); i++)
+        st.m_fibers[i]->Unref();
+
+    render(st.m_stacks, out);
+}
+}
@@ -0,0 +1,118 @@
+/*
+ *  fbRWLocker.cpp
+ *  Created on: Oct 17, 2026
+ *
+ *  Copyright (c) 2026 by Leo Hoo
+ *  lion@9465.net
+ */
+
+#include "service.h"
+
+namespace exlib {
+
+void RWLocker::rlock()
+{
+    m_lock.lock();
+
+    if (!m_writer && m_writeBlocks.empty()) {
+        m_readers++;
+        m_lock.unlock();
+        return;
+    }
+
+    Task_base* current = Thread_base::current();
+    assert(current != 0);
+
+    m_readBlocks.putTail(current);
+    current->suspend(m_lock);
+}
+
+bool RWLocker::tryrlock()
+{
+    m_lock.lock();
+
+    if (!m_writer && m_writeBlocks.empty()) {
+        m_readers++;
+        m_lock.unlock();
+        return true;
+    }
+
+    m_lock.unlock();
+    return false;
+}
+
+void RWLocker::runlock()
+{
+    Task_base* fb = 0;
+
+    m_lock.lock();
+
+    assert(m_readers > 0);
+    assert(!m_writer);
+
+    if (--m_readers == 0 && (fb = m_writeBlocks.getHead()) != 0)
+        m_writer = true;
+
+    m_lock.unlock();
+
+    if (fb)
+        fb->resume();
+}
+
+void RWLocker::wlock()
+{
+    m_lock.lock();
+
+    if (!m_writer && m_readers == 0) {
+        m_writer = true;
+        m_lock.unlock();
+        return;
+    }
+
+    Task_base* current = Thread_base::current();
+    assert(current != 0);
+
+    m_writeBlocks.putTail(current);
+    current->suspend(m_lock);
+}
+
+bool RWLocker::trywlock()
+{
+    m_lock.lock();
+
+    if (!m_writer && m_readers == 0) {
+        m_writer = true;
+        m_lock.unlock();
+        return true;
+    }
+
+    m_lock.unlock();
+    return false;
+}
+
+void RWLocker::wunlock()
+{
+    List<Task_base> readers;
+    Task_base* fb = 0;
+
+    m_lock.lock();
+
+    assert(m_writer);
+    assert(m_readers == 0);
+
+    if (!m_readBlocks.empty()) {
+        m_readBlocks.getList(readers);
+        m_readers = readers.count();
+        m_writer = false;
+    } else if ((fb = m_writeBlocks.getHead()) == 0)
+        m_writer = false;
+
+    m_lock.unlock();
+
+    if (fb)
+        fb->resume();
+
+    while ((fb = readers.getHead()) != 0)
+        fb->resume();
+}
+}
@@ -0,0 +1,461 @@
+/*
+ *  fbReactor.cpp
+ *  Created on: Oct 17, 2026
+ *
+ *  Copyright (c) 2026 by Leo Hoo
+ *  lion@9465.net
+ */
+
+#include "service.h"
+
+#ifndef _WIN32
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#include "reactor.h"
+#endif
+
+#ifdef Linux
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#endif
+
+namespace exlib {
+
+int64_t timer_now();
+void timer_kick_poller();
+
+#ifndef _WIN32
+
+static bool poll_fd(int32_t fd, int16_t events, int64_t us)
+{
+    struct pollfd pfd;
+    int32_t timeout = us < 0 ? -1 : (int32_t)((us + 999) / 1000);
+    int32_t r;
+
+    pfd.fd = fd;
+    pfd.events = events;
+    pfd.revents = 0;
+
+    while ((r = ::poll(&pfd, 1, timeout)) < 0 && errno == EINTR)
+        ;
+
+    return r > 0;
+}
+
+static Fiber* current_fiber()
+{
+    OSThread* thread_ = OSThread::current();
+
+    if (thread_ && thread_->is(Service::type))
+        return ((Service*)thread_)->running();
+
+    return NULL;
+}
+
+#endif
+
+#ifdef Linux
+
+#define FD_CHUNK_BITS 10
+#define FD_CHUNK (1 << FD_CHUNK_BITS)
+#define FD_CHUNKS 1024
+#define MAX_EVENTS 64
+
+class io_desc {
+public:
+    io_desc()
+        : m_added(false)
+    {
+    }
+
+public:
+    spinlock m_lock;
+    List<Task_base> m_readers;
+    List<Task_base> m_writers;
+    bool m_added;
+};
+
+class io_reactor {
+public:
+    io_reactor()
+    {
+        struct epoll_event ev;
+
+        m_epfd = epoll_create1(EPOLL_CLOEXEC);
+        m_evfd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+
+        ev.events = EPOLLIN;
+        ev.data.fd = m_evfd;
+        epoll_ctl(m_epfd, EPOLL_CTL_ADD, m_evfd, &ev);
+    }
+
+public:
+    bool active() const
+    {
+        return m_waiting > 0;
+    }
+
+    bool wait(int32_t fd, bool write, int64_t us)
+    {
+        int16_t events = write ? POLLOUT : POLLIN;
+        Fiber* fb = current_fiber();
+        io_desc* desc;
+
+        if (fb == NULL || us == 0 || (desc = get(fd, true)) == NULL)
+            return poll_fd(fd, events, us);
+
+        if (m_waiting.inc() == 1)
+            timer_kick_poller();
+
+        List<Task_base>& blocks = write ? desc->m_writers : desc->m_readers;
+        bool r = true;
+
+        desc->m_lock.lock();
+        blocks.putTail(fb);
+
+        if (!arm(fd, desc)) {
+            blocks.remove(fb);
+            desc->m_lock.unlock();
+            m_waiting.dec();
+
+            return poll_fd(fd, events, us);
+        }
+
+        if (us < 0)
+            fb->suspend(desc->m_lock);
+        else {
+            fb->suspend(desc->m_lock, blocks, us);
+            r = !fb->m_timer.timeout();
+        }
+
+        m_waiting.dec();
+        return r;
+    }
+
+    int32_t poll(int64_t us)
+    {
+        struct epoll_event evs[MAX_EVENTS];
+        int32_t timeout = us < 0 ? -1 : (int32_t)(us / 1000);
+        int32_t cnt = 0;
+        int32_t n, i;
+
+        n = epoll_wait(m_epfd, evs, MAX_EVENTS, timeout);
+
+        for (i = 0; i < n; i++) {
+            int32_t fd = evs[i].data.fd;
+            uint32_t events = evs[i].events;
+            List<Task_base> ready;
+            io_desc* desc;
+
+            if (fd == m_evfd) {
+                // leave the wakeup for the worker blocked in epoll_wait
+                if (us != 0) {
+                    uint64_t v;
+                    ssize_t r = ::read(m_evfd, &v, sizeof(v));
+                    (void)r;
+                }
+                continue;
+            }
+
+            if ((desc = get(fd, false)) == NULL)
+                continue;
+
+            desc->m_lock.lock();
+            if (events & (EPOLLIN | EPOLLRDHUP | EPOLLERR | EPOLLHUP))
+                take(desc->m_readers, ready);
+            if (events & (EPOLLOUT | EPOLLERR | EPOLLHUP))
+                take(desc->m_writers, ready);
+            if (!desc->m_readers.empty() || !desc->m_writers.empty())
+                arm(fd, desc);
+            desc->m_lock.unlock();
+
+            cnt += resume(ready);
+        }
+
+        return cnt;
+    }
+
+    void wake()
+    {
+        uint64_t v = 1;
+        ssize_t r = ::write(m_evfd, &v, sizeof(v));
+        (void)r;
+    }
+
+    int32_t close(int32_t fd)
+    {
+        io_desc* desc = get(fd, false);
+        List<Task_base> ready;
+        int32_t r;
+
+        if (desc) {
+            desc->m_lock.lock();
+            take(desc->m_readers, ready);
+            take(desc->m_writers, ready);
+            if (desc->m_added) {
+                epoll_ctl(m_epfd, EPOLL_CTL_DEL, fd, NULL);
+                desc->m_added = false;
+            }
+            desc->m_lock.unlock();
+        }
+
+        r = ::close(fd);
+        resume(ready);
+
+        return r;
+    }
+
+private:
+    io_desc* get(int32_t fd, bool create)
+    {
+        if (fd < 0 || fd >= FD_CHUNK * FD_CHUNKS)
+            return NULL;
+
+        int32_t idx = fd >> FD_CHUNK_BITS;
+        io_desc* chunk = m_table[idx];
+
+        if (chunk == NULL) {
+            if (!create)
+                return NULL;
+
+            io_desc* c = new io_desc[FD_CHUNK];
+            if ((chunk = m_table[idx].CompareAndSwap(NULL, c)) != NULL)
+                delete[] c;
+            else
+                chunk = c;
+        }
+
+        return &chunk[fd & (FD_CHUNK - 1)];
+    }
+
+    bool arm(int32_t fd, io_desc* desc)
+    {
+        struct epoll_event ev;
+        int32_t r;
+
+        ev.events = EPOLLONESHOT;
+        if (!desc->m_readers.empty())
+            ev.events |= EPOLLIN | EPOLLRDHUP;
+        if (!desc->m_writers.empty())
+            ev.events |= EPOLLOUT;
+        ev.data.fd = fd;
+
+        r = epoll_ctl(m_epfd, desc->m_added ? EPOLL_CTL_MOD : EPOLL_CTL_ADD, fd, &ev);
+        if (r < 0 && errno == ENOENT)
+            r = epoll_ctl(m_epfd, EPOLL_CTL_ADD, fd, &ev);
+        else if (r < 0 && errno == EEXIST)
+            r = epoll_ctl(m_epfd, EPOLL_CTL_MOD, fd, &ev);
+
+        desc->m_added = r == 0;
+        return r == 0;
+    }
+
+    static void take(List<Task_base>& blocks, List<Task_base>& ready)
+    {
+        Task_base* task;
+
+        while ((task = blocks.getHead()) != NULL)
+            if (task->m_timer.claim())
+                ready.putTail(task);
+    }
+
+    static int32_t resume(List<Task_base>& ready)
+    {
+        Task_base* task;
+        int32_t cnt = 0;
+
+        // only fibers wait here, send each back to the worker it ran on
+        while ((task = ready.getHead()) != NULL) {
+            Fiber* fb = (Fiber*)task;
+
+            fb->m_pService->post_home(fb);
+            cnt++;
+        }
+
+        return cnt;
+    }
+
+private:
+    int32_t m_epfd;
+    int32_t m_evfd;
+    exlib::atomic m_waiting;
+    atomic_ptr<io_desc> m_table[FD_CHUNKS];
+};
+
+static io_reactor* s_reactor;
+static spinlock s_reactor_lock;
+
+static io_reactor* reactor()
+{
+    if (s_reactor == NULL) {
+        s_reactor_lock.lock();
+        if (s_reactor == NULL) {
+            io_reactor* r = new io_reactor();
+            MemoryBarrier();
+            s_reactor = r;
+        }
+        s_reactor_lock.unlock();
+    }
+
+    return s_reactor;
+}
+
+bool reactor_active()
+{
+    return s_reactor && s_reactor->active();
+}
+
+int32_t reactor_poll(int64_t us)
+{
+    return s_reactor ? s_reactor->poll(us) : 0;
+}
+
+void reactor_wake()
+{
+    if (s_reactor)
+        s_reactor->wake();
+}
+
+bool Reactor::wait_readable(int32_t fd, int64_t us)
+{
+    return reactor()->wait(fd, false, us);
+}
+
+bool Reactor::wait_writable(int32_t fd, int64_t us)
+{
+    return reactor()->wait(fd, true, us);
+}
+
+int32_t Reactor::close(int32_t fd)
+{
+    if (s_reactor)
+        return s_reactor->close(fd);
+    return ::close(fd);
+}
+
+#else
+
+bool reactor_active()
+{
+    return false;
+}
+
+int32_t reactor_poll(int64_t us)
+{
+    return 0;
+}
+
+void reactor_wake()
+{
+}
+
+#ifndef _WIN32
+
+bool Reactor::wait_readable(int32_t fd, int64_t us)
+{
+    return poll_fd(fd, POLLIN, us);
+}
+
+bool Reactor::wait_writable(int32_t fd, int64_t us)
+{
+    return poll_fd(fd, POLLOUT, us);
+}
+
+int32_t Reactor::close(int32_t fd)
+{
+    return ::close(fd);
+}
+
+#endif
+
+#endif
+
+#ifndef _WIN32
+
+static int64_t time_left(int64_t deadline)
+{
+    if (deadline < 0)
+        return -1;
+
+    int64_t left = deadline - timer_now();
+    return left > 0 ? left : 0;
+}
+
+intptr_t Reactor::read(int32_t fd, void* buf, size_t len, int64_t us)
+{
+    int64_t deadline = us < 0 ? -1 : timer_now() + us;
+
+    while (true) {
+        intptr_t r = ::read(fd, buf, len);
+
+        if (r >= 0)
+            return r;
+        if (errno == EINTR)
+            continue;
+        if (errno != EAGAIN && errno != EWOULDBLOCK)
+            return -1;
+
+        int64_t left = time_left(deadline);
+        if (left == 0 || !wait_readable(fd, left)) {
+            errno = ETIMEDOUT;
+            return -1;
+        }
+    }
+}
+
+intptr_t Reactor::write(int32_t fd, const void* buf, size_t len, int64_t us)
+{
+    int64_t deadline = us < 0 ? -1 : timer_now() + us;
+
+    while (true) {
+        intptr_t r = ::write(fd, buf, len);
+
+        if (r >= 0)
+            return r;
+        if (errno == EINTR)
+            continue;
+        if (errno != EAGAIN && errno != EWOULDBLOCK)
+            return -1;
+
+        int64_t left = time_left(deadline);
+        if (left == 0 || !wait_writable(fd, left)) {
+            errno = ETIMEDOUT;
+            return -1;
+        }
+    }
+}
+
+int32_t Reactor::accept(int32_t fd, sockaddr* addr, socklen_t* addrlen, int64_t us)
+{
+    int64_t deadline = us < 0 ? -1 : timer_now() + us;
+
+    while (true) {
+#ifdef Linux
+        int32_t r = ::accept4(fd, addr, addrlen, SOCK_NONBLOCK | SOCK_CLOEXEC);
+#else
+        int32_t r = ::accept(fd, addr, addrlen);
+        if (r >= 0) {
+            fcntl(r, F_SETFL, fcntl(r, F_GETFL, 0) | O_NONBLOCK);
+            fcntl(r, F_SETFD, FD_CLOEXEC);
+        }
+#endif
+
+        if (r >= 0)
+            return r;
+        if (errno == EINTR || errno == ECONNABORTED)
+            continue;
+        if (errno != EAGAIN && errno != EWOULDBLOCK)
+            return -1;
+
+        int64_t left = time_left(deadline);
+        if (left == 0 || !wait_readable(fd, left)) {
+            errno = ETIMEDOUT;
+            return -1;
+        }
+    }
+}
+
+#endif
+}
@@ -26,12 +26,42 @@ void Semaphore::wait()
     }
 }
 
+bool Semaphore::wait(int64_t us)
+{
+    if (us < 0) {
+        wait();
+        return true;
+    }
+
+    m_lock.lock();
+
+    if (m_count > 0) {
+        m_count--;
+        m_lock.unlock();
+        return true;
+    }
+
+    if (us == 0) {
+        m_lock.unlock();
+        return false;
+    }
+
+    Task_base* current = Thread_base::current();
+    assert(current != 0);
+
+    m_blocks.putTail(current);
+    current->suspend(m_lock, m_blocks, us);
+
+    return !current->m_timer.timeout();
+}
+
 void Semaphore::post()
 {
     Task_base* fb;
 
     m_lock.lock();
-    fb = m_blocks.getHead();
+    while ((fb = m_blocks.getHead()) != 0 && !fb->m_timer.claim())
+        ;
     if (fb == 0)
         m_count++;
     m_lock.unlock();
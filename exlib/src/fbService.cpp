@@ -10,23 +10,50 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include <assert.h>
+#include <thread>
+#include <new>
 
 #include "osconfig.h"
 #include "service.h"
 #include "thread.h"
+#include "arena.h"
 
 namespace exlib {
 
 #define FB_STK_ALIGN 256
 
-void init_timer();
+bool timer_process(Service* poller, int64_t& wait, int64_t& now);
+bool timer_unpoll(Service* poller);
+int64_t timer_now();
+intptr_t timer_count();
+bool reactor_active();
+int32_t reactor_poll(int64_t us);
+void reactor_wake();
+int32_t affinity_nodes();
+int32_t affinity_bind(int32_t idx, int32_t mode);
 
 static bool s_service_inited;
 static Service* s_service = NULL;
+static int32_t s_cpus = 1;
+static int32_t s_affinity = Service::AFFINITY_NONE;
+static int32_t s_nodes = 1;
+static int32_t s_batchWeight = 8;
+static exlib::atomic s_created;
+static exlib::atomic s_destroyed;
+static exlib::atomic s_trimGen;
+
+void fiber_destroyed()
+{
+    s_destroyed.inc();
+}
 
-void Service::init(int32_t workers)
+void Service::init(int32_t workers, int32_t affinity)
 {
     if (!s_service) {
+        s_affinity = affinity;
+        if (affinity != AFFINITY_NONE)
+            s_nodes = affinity_nodes();
+
         static Service _srv(workers);
         s_service = &_srv;
         s_service->m_main.saveStackGuard();
@@ -34,6 +61,16 @@ void Service::init(int32_t workers)
     }
 }
 
+int32_t Service::cpus()
+{
+    return s_cpus;
+}
+
+void Service::setBatchWeight(int32_t weight)
+{
+    s_batchWeight = weight > 0 ? weight : 1;
+}
+
 Thread_base* Thread_base::current()
 {
     if (!s_service_inited)
@@ -60,35 +97,111 @@ Service* Service::current()
     return (Service*)thread_;
 }
 
-#ifdef DEBUG
+#define FIBER_SHARDS 16
 
-static LockedList<linkitem> s_fibers;
-static spinlock s_locker;
+class fiber_shard {
+public:
+    spinlock m_lock;
+    List<linkitem> m_fibers;
+};
 
-void Service::forEach(void (*func)(Fiber*))
+static fiber_shard s_fibers[FIBER_SHARDS];
+
+static fiber_shard& shard_of(Fiber* fb)
+{
+    return s_fibers[((intptr_t)fb >> 6) & (FIBER_SHARDS - 1)];
+}
+
+exlib::atomic Service::s_freeze;
+
+// the callback runs under the shard lock, so a fiber it is given cannot
+// exit and be freed before it returns. keep it short, Create and fiber
+// exit wait on the same lock.
+void Service::forEach(void (*func)(Fiber*, void*), void* data)
 {
-    s_locker.lock();
+    int32_t i;
 
-    linkitem* p = s_fibers.head();
+    for (i = 0; i < FIBER_SHARDS; i++) {
+        fiber_shard& shard = s_fibers[i];
 
-    while (p) {
-        Fiber* zfb = 0;
-        func((Fiber*)((intptr_t)p - (intptr_t)(&zfb->m_link)));
+        shard.m_lock.lock();
 
-        p = s_fibers.next(p);
+        linkitem* p = shard.m_fibers.head();
+
+        while (p) {
+            Fiber* zfb = 0;
+            func((Fiber*)((intptr_t)p - (intptr_t)(&zfb->m_link)), data);
+
+            p = shard.m_fibers.next(p);
+        }
+
+        shard.m_lock.unlock();
     }
+}
+
+static void call_plain(Fiber* fb, void* data)
+{
+    (*(void (**)(Fiber*))data)(fb);
+}
+
+void Service::forEach(void (*func)(Fiber*))
+{
+    forEach(call_plain, &func);
+}
+
+// workers stopped by s_freeze sleep on m_thaw until thaw() lets them go,
+// m_frozen decides whether a post is owed as m_parked does for m_sem
+void Service::freeze_wait()
+{
+    m_inFiber = 0;
+
+    m_frozen = 1;
+    if (s_freeze || m_frozen.CompareAndSwap(1, 0) != 1)
+        m_thaw.Wait();
 
-    s_locker.unlock();
+    m_inFiber = 1;
 }
 
-#endif
+void Service::thaw()
+{
+    Service* master = s_service;
+    int32_t cnt = (int32_t)master->m_poolSize;
+    int32_t i;
+
+    s_freeze = 0;
+
+    for (i = 0; i < cnt; i++) {
+        Service* worker = master->m_pool[i];
+
+        if (worker && worker->m_frozen.CompareAndSwap(1, 0) == 1)
+            worker->m_thaw.Post();
+    }
+}
 
 Service::Service()
     : m_master(s_service)
     , m_main(this, NULL, NULL)
     , m_running(&m_main)
     , m_cb(NULL)
+    , m_pool(NULL)
+    , m_poolCap(0)
+    , m_index(0)
+    , m_node(0)
+    , m_tick(0)
+    , m_batchTurn(0)
+    , m_now(0)
+    , m_switches(0)
+    , m_sliceStart(0)
+    , m_maxSlice(0)
+    , m_fiberCount(0)
+    , m_trimGen(0)
+    , m_recycled(0)
+    , m_chunkCache(NULL)
+    , m_chunkCount(0)
 {
+    memset(m_maxSliceName, 0, sizeof(m_maxSliceName));
+    memset(m_fiberCache, 0, sizeof(m_fiberCache));
+    memset(m_cacheStack, 0, sizeof(m_cacheStack));
     m_main.set_name("main");
     m_main.Ref();
 }
@@ -99,15 +212,37 @@ Service::Service(int32_t workers)
     , m_running(&m_main)
     , m_cb(NULL)
     , m_workers(workers - 1)
+    , m_index(0)
+    , m_node(0)
+    , m_tick(0)
+    , m_batchTurn(0)
+    , m_now(0)
+    , m_switches(0)
+    , m_sliceStart(0)
+    , m_maxSlice(0)
+    , m_fiberCount(0)
+    , m_trimGen(0)
+    , m_recycled(0)
+    , m_chunkCache(NULL)
+    , m_chunkCount(0)
 {
+    memset(m_maxSliceName, 0, sizeof(m_maxSliceName));
+    memset(m_fiberCache, 0, sizeof(m_fiberCache));
+    memset(m_cacheStack, 0, sizeof(m_cacheStack));
     m_main.set_name("main");
     m_main.m_ctx = convert_Fiber(NULL);
     m_main.Ref();
 
-    if (!s_service_inited) {
-        s_service_inited = true;
-        init_timer();
-    }
+    m_poolCap = workers > 1 ? workers : 1;
+    m_pool = new Service*[m_poolCap];
+    memset(m_pool, 0, sizeof(Service*) * m_poolCap);
+    attach(this);
+
+    s_cpus = (int32_t)std::thread::hardware_concurrency();
+    if (s_cpus < 1)
+        s_cpus = 1;
+
+    s_service_inited = true;
 }
 
 static void _fiber_proc(void* param)
@@ -123,11 +258,11 @@ static void _fiber_proc(void* param)
     public:
         virtual void invoke()
         {
-#ifdef DEBUG
-            s_locker.lock();
-            s_fibers.remove(&m_fb->m_link);
-            s_locker.unlock();
-#endif
+            fiber_shard& shard = shard_of(m_fb);
+
+            shard.m_lock.lock();
+            shard.m_fibers.remove(&m_fb->m_link);
+            shard.m_lock.unlock();
 
             m_fb->m_joins.set();
             m_fb->Unref();
@@ -146,30 +281,556 @@ static void _fiber_proc(void* param)
 
 void Service::Create(fiber_func func, void* data, int32_t stacksize, const char* name, Fiber** retVal)
 {
-    Fiber* fb = new Fiber(s_service, func, data);
-    fb->m_ctx = create_fiber(stacksize, _fiber_proc, fb);
+    OSThread* thread_ = OSThread::current();
+    Fiber* fb = NULL;
+
+    if (thread_ && thread_->is(Service::type))
+        fb = ((Service*)thread_)->reuse(func, data, stacksize);
+
+    if (fb == NULL) {
+        fb = new Fiber(s_service, func, data);
+        fb->m_ctx = create_fiber(stacksize, _fiber_proc, fb);
+        fb->m_stacksize = stacksize;
+
+        if (fb->m_ctx == NULL) {
+            delete fb;
+
+            if (retVal)
+                *retVal = NULL;
+            return;
+        }
+    }
+
+    if (name)
+        fb->set_name(name);
+
+    fiber_shard& shard = shard_of(fb);
 
-#ifdef DEBUG
-    s_locker.lock();
-    s_fibers.putTail(&fb->m_link);
-    s_locker.unlock();
-#endif
+    shard.m_lock.lock();
+    shard.m_fibers.putTail(&fb->m_link);
+    shard.m_lock.unlock();
 
     if (retVal) {
         *retVal = fb;
         fb->Ref();
     }
 
+    s_created.inc();
+
     fb->Ref();
     fb->resume();
 }
 
+// cached fibers are kept per stack size, a bucket with nothing in it can be
+// taken over by another size
+int32_t Service::cache_bucket(int32_t stacksize, bool create)
+{
+    int32_t i;
+
+    for (i = 0; i < FIBER_BUCKETS; i++)
+        if (m_cacheStack[i] == stacksize)
+            return i;
+
+    if (create)
+        for (i = 0; i < FIBER_BUCKETS; i++)
+            if (m_fiberCache[i] == NULL) {
+                m_cacheStack[i] = stacksize;
+                return i;
+            }
+
+    return -1;
+}
+
+Fiber* Service::reuse(fiber_func func, void* data, int32_t stacksize)
+{
+    int32_t i = cache_bucket(stacksize, false);
+    Fiber* fb;
+
+    if (i < 0 || (fb = m_fiberCache[i]) == NULL)
+        return NULL;
+
+    m_fiberCache[i] = (Fiber*)fb->m_next;
+    m_fiberCount--;
+    m_recycled++;
+
+    void* ctx = fb->m_ctx;
+
+    fb->~Fiber();
+    new (fb) Fiber(s_service, func, data);
+
+    fb->m_ctx = reset_fiber(ctx, stacksize, _fiber_proc, fb);
+    fb->m_stacksize = stacksize;
+
+    return fb;
+}
+
+bool Service::recycle(Fiber* fb)
+{
+    int32_t i;
+
+    if (fb->m_stacksize == 0 || m_fiberCount >= FIBER_CACHE || m_trimGen != s_trimGen)
+        return false;
+
+    if ((i = cache_bucket(fb->m_stacksize, true)) < 0)
+        return false;
+
+    fb->m_next = m_fiberCache[i];
+    m_fiberCache[i] = fb;
+    m_fiberCount++;
+
+    return true;
+}
+
+arena_chunk* Service::reuse_chunk()
+{
+    arena_chunk* chunk = m_chunkCache;
+
+    if (chunk) {
+        m_chunkCache = chunk->m_next;
+        m_chunkCount--;
+    }
+
+    return chunk;
+}
+
+bool Service::recycle_chunk(arena_chunk* chunk)
+{
+    if (m_chunkCount >= CHUNK_CACHE || m_trimGen != s_trimGen)
+        return false;
+
+    chunk->m_next = m_chunkCache;
+    m_chunkCache = chunk;
+    m_chunkCount++;
+
+    return true;
+}
+
+void Service::trim_cache()
+{
+    arena_chunk* chunk;
+    Fiber* fb;
+    int32_t i;
+
+    m_trimGen = s_trimGen;
+
+    for (i = 0; i < FIBER_BUCKETS; i++)
+        while ((fb = m_fiberCache[i]) != NULL) {
+            m_fiberCache[i] = (Fiber*)fb->m_next;
+            m_fiberCount--;
+
+            delete_fiber(fb->m_ctx);
+            delete fb;
+        }
+
+    while ((chunk = m_chunkCache) != NULL) {
+        m_chunkCache = chunk->m_next;
+        m_chunkCount--;
+
+        free(chunk);
+    }
+}
+
+void Service::trim()
+{
+    Service* master = s_service;
+    int32_t cnt;
+    int32_t i;
+
+    if (master == NULL)
+        return;
+
+    cnt = (int32_t)master->m_poolSize;
+    s_trimGen.inc();
+
+    for (i = 0; i < cnt; i++) {
+        Service* worker = master->m_pool[i];
+
+        if (worker)
+            worker->unpark();
+    }
+}
+
+void Service::attach(Service* worker)
+{
+    intptr_t idx = m_poolSize.inc() - 1;
+
+    assert(idx < m_poolCap);
+    worker->m_index = (int32_t)idx;
+    m_pool[idx] = worker;
+}
+
+Service* Service::master()
+{
+    return s_service;
+}
+
+void Service::bind()
+{
+    m_node = affinity_bind(m_index, s_affinity);
+}
+
+bool Service::unpark()
+{
+    Service* master = m_master ? m_master : this;
+
+    if (m_parked.CompareAndSwap(1, 0) != 1)
+        return false;
+
+    master->m_idleWorkers.dec();
+    m_sem.Post();
+
+    if (m_inPoll)
+        reactor_wake();
+
+    return true;
+}
+
+void Service::wakeup()
+{
+    Service* master = m_master ? m_master : this;
+
+    if (master->m_idleWorkers <= 0 || master->m_spinning > 0)
+        return;
+
+    int32_t cnt = (int32_t)master->m_poolSize;
+    int32_t i;
+
+    for (i = 0; i < (s_nodes > 1 ? cnt * 2 : cnt); i++) {
+        Service* worker = master->m_pool[i % cnt];
+
+        if (worker == NULL)
+            continue;
+        if (s_nodes > 1 && (worker->m_node == m_node) != (i < cnt))
+            continue;
+
+        if (worker->unpark())
+            break;
+    }
+}
+
+void timer_kick(Service* poller)
+{
+    if (poller)
+        poller->unpark();
+    else if (s_service)
+        s_service->wakeup();
+}
+
+void Service::post(Fiber* fiber, bool fifo)
+{
+    OSThread* thread_ = OSThread::current();
+    bool batch = fiber->m_priority == Fiber::PRIORITY_BATCH;
+
+    if ((++fiber->m_posts & (STATS_SAMPLE - 1)) == 0)
+        fiber->m_readyAt = timer_now();
+
+    if (batch && fiber->m_deadline && timer_now() >= fiber->m_deadline)
+        batch = false;
+
+    if (thread_ && thread_->is(Service::type))
+        ((Service*)thread_)->put_local(fiber, fifo, batch);
+    else if (batch)
+        m_batchInbox.putTail(fiber);
+    else
+        m_inbox.putTail(fiber);
+
+    wakeup();
+}
+
+// post() queues on the calling worker, this queues on the worker the fiber
+// last ran on (m_pService) so it stays with its warm cache and memory.
+// the home worker is unparked if it sleeps, otherwise it finds the fiber in
+// its inbox and idle workers may still steal it.
+void Service::post_home(Fiber* fiber)
+{
+    OSThread* thread_ = OSThread::current();
+
+    if (thread_ == this || !thread_ || !thread_->is(Service::type)) {
+        post(fiber);
+        return;
+    }
+
+    if ((++fiber->m_posts & (STATS_SAMPLE - 1)) == 0)
+        fiber->m_readyAt = timer_now();
+
+    if (fiber->m_priority == Fiber::PRIORITY_BATCH
+        && !(fiber->m_deadline && timer_now() >= fiber->m_deadline))
+        m_batchInbox.putTail(fiber);
+    else
+        m_inbox.putTail(fiber);
+
+    unpark();
+}
+
+void Service::put_local(Fiber* fiber, bool fifo, bool batch)
+{
+    if (batch) {
+        if (!m_batchq.put(fiber))
+            m_batchInbox.putTail(fiber);
+        return;
+    }
+
+    if (!fifo) {
+        fiber = m_lifo.xchg(fiber);
+        if (fiber == NULL)
+            return;
+    }
+
+    if (!m_runq.put(fiber))
+        m_inbox.putTail(fiber);
+}
+
+Fiber* Service::get_local()
+{
+    return m_runq.get();
+}
+
+static Fiber* get_list(MPSCList<Fiber>& list, exlib::atomic& busy, bool wait)
+{
+    Fiber* fb;
+
+    if (list.empty())
+        return NULL;
+
+    while (busy.CompareAndSwap(0, 1) != 0) {
+        if (!wait)
+            return NULL;
+        yield();
+    }
+
+    fb = list.getHead();
+    busy = 0;
+
+    return fb;
+}
+
+Fiber* Service::get_inbox(bool wait)
+{
+    return get_list(m_inbox, m_inboxBusy, wait);
+}
+
+Fiber* Service::get_batch(bool wait)
+{
+    Fiber* fb = m_batchq.get();
+
+    if (fb == NULL)
+        fb = get_list(m_batchInbox, m_batchBusy, wait);
+
+    return fb;
+}
+
+// post() only checks the deadline of a batch fiber as it is queued. once in
+// a while walk the batch queues and move the fibers that went overdue
+// while waiting over to the latency class.
+void Service::promote_batch()
+{
+    int32_t n = m_batchq.count() + m_batchInbox.count();
+    Fiber* fb;
+
+    if (n > RUNQ_SIZE)
+        n = RUNQ_SIZE;
+
+    while (n-- > 0 && (fb = get_batch(false)) != NULL)
+        put_local(fb, true, !(fb->m_deadline && m_now >= fb->m_deadline));
+}
+
+Fiber* Service::steal()
+{
+    Service* master = m_master ? m_master : this;
+    int32_t cnt = (int32_t)master->m_poolSize;
+    int32_t i;
+
+    // with more than one node, visit same-node victims on the first lap
+    for (i = 0; i < (s_nodes > 1 ? cnt * 2 : cnt); i++) {
+        Service* victim = master->m_pool[(m_tick + i) % cnt];
+        Fiber* fb;
+
+        if (victim == NULL || victim == this)
+            continue;
+        if (s_nodes > 1 && (victim->m_node == m_node) != (i < cnt))
+            continue;
+
+        if ((fb = victim->get_local()) != NULL)
+            return fb;
+
+        if ((fb = victim->get_inbox(false)) != NULL)
+            return fb;
+
+        if (victim->m_lifo && (fb = victim->m_lifo.xchg(NULL)) != NULL)
+            return fb;
+
+        if ((fb = victim->get_batch(false)) != NULL)
+            return fb;
+    }
+
+    return NULL;
+}
+
+Fiber* Service::spin()
+{
+    Service* master = m_master ? m_master : this;
+    Fiber* fb = NULL;
+    int32_t i;
+
+    if (s_cpus < 2)
+        return NULL;
+
+    if (master->m_spinning * 2 >= master->m_poolSize - master->m_idleWorkers)
+        return NULL;
+
+    master->m_spinning.inc();
+
+    for (i = 0; i < SPIN_ROUNDS && fb == NULL; i++) {
+        yield();
+
+        if (m_lifo)
+            fb = m_lifo.xchg(NULL);
+        if (fb == NULL)
+            fb = get_local();
+        if (fb == NULL)
+            fb = get_inbox(true);
+        if (fb == NULL)
+            fb = get_batch(true);
+        if (fb == NULL)
+            fb = steal();
+    }
+
+    master->m_spinning.dec();
+
+    if (fb)
+        wakeup();
+
+    return fb;
+}
+
+Fiber* Service::next()
+{
+    Service* master = m_master ? m_master : this;
+    Fiber* fb = NULL;
+    bool polled = false;
+    bool granted;
+    int64_t wait;
+
+    while (true) {
+        timer_process(NULL, wait, m_now);
+
+        if (++m_tick % 61 == 0) {
+            if (m_trimGen != s_trimGen)
+                trim_cache();
+            if (!m_batchq.empty() || !m_batchInbox.empty())
+                promote_batch();
+            if (reactor_active())
+                reactor_poll(0);
+            if ((fb = get_inbox(true)) == NULL)
+                fb = get_local();
+        }
+
+        // let one batch fiber through for every s_batchWeight latency picks
+        if (fb == NULL && m_batchTurn <= 0 && (fb = get_batch(true)) != NULL)
+            m_batchTurn = s_batchWeight;
+
+        if (fb == NULL) {
+            if (m_lifo)
+                fb = m_lifo.xchg(NULL);
+            if (fb == NULL)
+                fb = get_local();
+            if (fb == NULL)
+                fb = get_inbox(true);
+            if (fb && m_batchTurn > 0)
+                m_batchTurn--;
+        }
+
+        if (fb == NULL)
+            fb = get_batch(true);
+        if (fb == NULL)
+            fb = steal();
+        if (fb == NULL)
+            fb = spin();
+        if (fb)
+            break;
+
+        if (reactor_active() && reactor_poll(0) > 0)
+            continue;
+
+        if (m_trimGen != s_trimGen)
+            trim_cache();
+
+        m_parked = 1;
+        master->m_idleWorkers.inc();
+
+        if ((fb = get_local()) == NULL && (fb = get_inbox(true)) == NULL
+            && (fb = get_batch(true)) == NULL)
+            fb = steal();
+
+        if (fb) {
+            if (m_parked.CompareAndSwap(1, 0) == 1)
+                master->m_idleWorkers.dec();
+            else
+                m_sem.Wait();
+            break;
+        }
+
+        granted = timer_process(this, wait, m_now);
+
+        if (granted && reactor_active() && (wait < 0 || wait >= 1000)) {
+            m_inPoll = 1;
+            if (m_parked == 1)
+                reactor_poll(wait);
+            m_inPoll = 0;
+
+            if (m_parked.CompareAndSwap(1, 0) == 1)
+                master->m_idleWorkers.dec();
+            else
+                m_sem.Wait();
+        } else if (granted && wait >= 0) {
+            if (!m_sem.TimedWaitUs(wait)) {
+                if (m_parked.CompareAndSwap(1, 0) == 1)
+                    master->m_idleWorkers.dec();
+                else
+                    m_sem.Wait();
+            }
+        } else
+            m_sem.Wait();
+
+        polled = timer_unpoll(this);
+    }
+
+    if (polled)
+        wakeup();
+
+    if (master->m_idleWorkers == 0 && master->m_workers > 0) {
+        if (master->m_workers.dec() < 0)
+            master->m_workers.inc();
+        else {
+            master->m_idleWorkers.inc();
+            Service* worker = new Service();
+            worker->start();
+        }
+    }
+
+    return fb;
+}
+
 void Service::dispatch()
 {
     assert(s_service != 0);
     s_service->dispatch_loop();
 }
 
+void Service::account(Fiber* fb, int64_t now)
+{
+    int64_t slice = now - m_sliceStart;
+
+    fb->m_runTime += slice;
+
+    if (slice > m_maxSlice) {
+        m_statsLock.lock();
+        m_maxSlice = slice;
+        memcpy(m_maxSliceName, fb->name_, sizeof(m_maxSliceName));
+        m_statsLock.unlock();
+    }
+}
+
 void Service::dispatch_loop()
 {
     while (true) {
@@ -183,9 +844,86 @@ void Service::dispatch_loop()
         Fiber* fb = next();
         assert(fb != 0);
 
+        m_sliceStart = m_now;
+        if (fb->m_readyAt) {
+            fb->m_waitTime += (m_now - fb->m_readyAt) * STATS_SAMPLE;
+            fb->m_readyAt = 0;
+        }
+        m_switches++;
+
         m_running = fb;
+        m_inFiber = 1;
+        while (s_freeze)
+            freeze_wait();
+
         fb->m_pService = this;
         switch_fiber(m_main.m_ctx, fb->m_ctx);
+        m_inFiber = 0;
+
+        account(fb, timer_now());
+    }
+}
+
+int32_t Service::stats(Stats& s, WorkerStats* workers, int32_t count)
+{
+    int32_t cnt = (int32_t)s_service->m_poolSize;
+    int32_t i;
+
+    memset(&s, 0, sizeof(s));
+
+    s.workers = cnt;
+    s.idleWorkers = (int32_t)s_service->m_idleWorkers;
+    s.spinning = (int32_t)s_service->m_spinning;
+    s.timers = (int32_t)timer_count();
+    s.created = s_created;
+    s.destroyed = s_destroyed;
+
+    for (i = 0; i < cnt; i++) {
+        Service* worker = s_service->m_pool[i];
+        WorkerStats ws;
+
+        if (worker == NULL)
+            continue;
+
+        ws.runnable = worker->m_runq.count() + worker->m_inbox.count() + (worker->m_lifo ? 1 : 0)
+            + worker->m_batchq.count() + worker->m_batchInbox.count();
+        ws.switches = worker->m_switches;
+
+        worker->m_statsLock.lock();
+        ws.maxSlice = worker->m_maxSlice;
+        memcpy(ws.maxSliceName, worker->m_maxSliceName, sizeof(ws.maxSliceName));
+        worker->m_statsLock.unlock();
+
+        s.runnable += ws.runnable;
+        s.switches += ws.switches;
+        s.recycled += worker->m_recycled;
+        s.cached += worker->m_fiberCount;
+        if (ws.maxSlice > s.maxSlice) {
+            s.maxSlice = ws.maxSlice;
+            memcpy(s.maxSliceName, ws.maxSliceName, sizeof(s.maxSliceName));
+        }
+
+        if (i < count)
+            workers[i] = ws;
+    }
+
+    return cnt;
+}
+
+void Service::resetMaxSlice()
+{
+    int32_t cnt = (int32_t)s_service->m_poolSize;
+    int32_t i;
+
+    for (i = 0; i < cnt; i++) {
+        Service* worker = s_service->m_pool[i];
+
+        if (worker) {
+            worker->m_statsLock.lock();
+            worker->m_maxSlice = 0;
+            memset(worker->m_maxSliceName, 0, sizeof(worker->m_maxSliceName));
+            worker->m_statsLock.unlock();
+        }
     }
 }
 }
@@ -47,45 +47,33 @@ asm(".globl nix_switch, _nix_switch");
 asm("nix_switch:");
 asm("_nix_switch:");
 
-asm("    movq    %rbp,(%rdi)");
+asm("    popq    %rdx");
 
+asm("    movq    %rbp,(%rdi)");
 asm("    movq    %rbx,0x08(%rdi)");
-asm("    movq    %rcx,0x10(%rdi)");
-asm("    movq    %rdx,0x18(%rdi)");
-asm("    movq    %rsi,0x20(%rdi)");
-asm("    movq    %rdi,0x28(%rdi)");
-asm("    movq    %r8,0x30(%rdi)");
-asm("    movq    %r9,0x38(%rdi)");
-asm("    movq    %r10,0x40(%rdi)");
-asm("    movq    %r11,0x48(%rdi)");
 asm("    movq    %r12,0x50(%rdi)");
 asm("    movq    %r13,0x58(%rdi)");
 asm("    movq    %r14,0x60(%rdi)");
 asm("    movq    %r15,0x68(%rdi)");
-
 asm("    movq    %rsp,0x70(%rdi)");
+asm("    movq    %rdx,0x78(%rdi)");
 
-asm("    movq    %rsi, %rdi");
-
-asm("    movq    (%rdi), %rbp");
-asm("    movq    0x08(%rdi), %rbx");
-asm("    movq    0x10(%rdi), %rcx");
-asm("    movq    0x18(%rdi), %rdx");
-asm("    movq    0x20(%rdi), %rsi");
+asm("    movq    (%rsi), %rbp");
+asm("    movq    0x08(%rsi), %rbx");
+asm("    movq    0x50(%rsi), %r12");
+asm("    movq    0x58(%rsi), %r13");
+asm("    movq    0x60(%rsi), %r14");
+asm("    movq    0x68(%rsi), %r15");
+asm("    movq    0x70(%rsi), %rsp");
 
-asm("    movq    0x30(%rdi), %r8");
-asm("    movq    0x38(%rdi), %r9");
-asm("    movq    0x40(%rdi), %r10");
-asm("    movq    0x48(%rdi), %r11");
-asm("    movq    0x50(%rdi), %r12");
-asm("    movq    0x58(%rdi), %r13");
-asm("    movq    0x60(%rdi), %r14");
-asm("    movq    0x68(%rdi), %r15");
-asm("    movq    0x70(%rdi), %rsp");
+asm("    jmpq    *0x78(%rsi)");
 
-asm("    movq    0x28(%rdi), %rdi");
+asm(".globl nix_start, _nix_start");
+asm("nix_start:");
+asm("_nix_start:");
 
-asm("    ret");
+asm("    movq    %r13, %rdi");
+asm("    jmpq    *%r12");
 
 #elif defined(i386)
 
@@ -161,83 +149,41 @@ asm(".globl nix_switch, _nix_switch");
 asm("nix_switch:");
 asm("_nix_switch:");
 
-asm("    stp x0, x1, [x0]");
-asm("    stp x2, x3, [x0,#16]");
-asm("    stp x4, x5, [x0,#32]");
-asm("    stp x6, x7, [x0,#48]");
-asm("    stp x8, x9, [x0,#64]");
-asm("    stp x10, x11, [x0,#80]");
-asm("    stp x12, x13, [x0,#96]");
-asm("    stp x14, x15, [x0,#112]");
-asm("    stp x16, x17, [x0,#128]");
-asm("    stp x18, x19, [x0,#144]");
-asm("    stp x20, x21, [x0,#160]");
-asm("    stp x22, x23, [x0,#176]");
-asm("    stp x24, x25, [x0,#192]");
-asm("    stp x26, x27, [x0,#208]");
-asm("    stp x28, x29, [x0,#224]");
-
-asm("    mov x8, sp");
-asm("    stp x30, x8, [x0,#240]");
-
-asm("    stp d0, d1, [x0,#256]");
-asm("    stp d2, d3, [x0,#272]");
-asm("    stp d4, d5, [x0,#288]");
-asm("    stp d6, d7, [x0,#304]");
+asm("    stp x19, x20, [x0,#152]");
+asm("    stp x21, x22, [x0,#168]");
+asm("    stp x23, x24, [x0,#184]");
+asm("    stp x25, x26, [x0,#200]");
+asm("    stp x27, x28, [x0,#216]");
+asm("    mov x2, sp");
+asm("    stp x29, x30, [x0,#232]");
+asm("    str x2, [x0,#248]");
 asm("    stp d8, d9, [x0,#320]");
 asm("    stp d10, d11, [x0,#336]");
 asm("    stp d12, d13, [x0,#352]");
 asm("    stp d14, d15, [x0,#368]");
-asm("    stp d16, d17, [x0,#384]");
-asm("    stp d18, d19, [x0,#400]");
-asm("    stp d20, d21, [x0,#416]");
-asm("    stp d22, d23, [x0,#432]");
-asm("    stp d24, d25, [x0,#448]");
-asm("    stp d26, d27, [x0,#464]");
-asm("    stp d28, d29, [x0,#480]");
-asm("    stp d30, d31, [x0,#496]");
-
-asm("    mov x0, x1");
-
-asm("    ldp x2, x3, [x0,#16]");
-asm("    ldp x4, x5, [x0,#32]");
-asm("    ldp x6, x7, [x0,#48]");
-asm("    ldp x8, x9, [x0,#64]");
-asm("    ldp x10, x11, [x0,#80]");
-asm("    ldp x12, x13, [x0,#96]");
-asm("    ldp x14, x15, [x0,#112]");
-asm("    ldp x16, x17, [x0,#128]");
-asm("    ldp x18, x19, [x0,#144]");
-asm("    ldp x20, x21, [x0,#160]");
-asm("    ldp x22, x23, [x0,#176]");
-asm("    ldp x24, x25, [x0,#192]");
-asm("    ldp x26, x27, [x0,#208]");
-asm("    ldp x28, x29, [x0,#224]");
-
-asm("    ldp x30, x1, [x0,#240]");
-asm("    mov sp, x1");
-
-asm("    ldp d0, d1, [x0,#256]");
-asm("    ldp d2, d3, [x0,#272]");
-asm("    ldp d4, d5, [x0,#288]");
-asm("    ldp d6, d7, [x0,#304]");
-asm("    ldp d8, d9, [x0,#320]");
-asm("    ldp d10, d11, [x0,#336]");
-asm("    ldp d12, d13, [x0,#352]");
-asm("    ldp d14, d15, [x0,#368]");
-asm("    ldp d16, d17, [x0,#384]");
-asm("    ldp d18, d19, [x0,#400]");
-asm("    ldp d20, d21, [x0,#416]");
-asm("    ldp d22, d23, [x0,#432]");
-asm("    ldp d24, d25, [x0,#448]");
-asm("    ldp d26, d27, [x0,#464]");
-asm("    ldp d28, d29, [x0,#480]");
-asm("    ldp d30, d31, [x0,#496]");
-
-asm("    ldp x0, x1, [x0]");
+
+asm("    ldp x19, x20, [x1,#152]");
+asm("    ldp x21, x22, [x1,#168]");
+asm("    ldp x23, x24, [x1,#184]");
+asm("    ldp x25, x26, [x1,#200]");
+asm("    ldp x27, x28, [x1,#216]");
+asm("    ldp x29, x30, [x1,#232]");
+asm("    ldr x2, [x1,#248]");
+asm("    mov sp, x2");
+asm("    ldp d8, d9, [x1,#320]");
+asm("    ldp d10, d11, [x1,#336]");
+asm("    ldp d12, d13, [x1,#352]");
+asm("    ldp d14, d15, [x1,#368]");
 
 asm("    ret");
 
+asm(".globl nix_start, _nix_start");
+asm("nix_start:");
+asm("_nix_start:");
+
+asm("    mov x0, x20");
+asm("    br x19");
+
 #elif defined(mips)
 
 asm(".globl nix_switch, _nix_switch");
@@ -11,49 +11,114 @@
 
 namespace exlib {
 
-static char s_tls[TLS_SIZE];
-static Fiber::tls_free s_tls_free[TLS_SIZE];
+static char s_tls[TLS_MAX];
+static Fiber::tls_free s_tls_free[TLS_MAX];
+static int32_t s_tls_top;
+static spinlock s_tls_lock;
 
 int32_t Thread_base::tlsAlloc(tls_free _free)
 {
     int32_t i;
 
-    for (i = 0; i < TLS_SIZE; i++)
+    s_tls_lock.lock();
+    for (i = 0; i < TLS_MAX; i++)
         if (s_tls[i] == 0) {
             s_tls[i] = 1;
             s_tls_free[i] = _free;
+            if (i >= s_tls_top)
+                s_tls_top = i + 1;
+            s_tls_lock.unlock();
             return i;
         }
+    s_tls_lock.unlock();
 
     return -1;
 }
 
 void* Thread_base::tlsGet(int32_t idx)
 {
-    assert(current() != 0);
-    return current()->m_tls[idx];
+    Thread_base* cur = current();
+
+    assert(cur != 0);
+    assert(idx >= 0 && idx < TLS_MAX);
+
+    if (idx < TLS_SIZE)
+        return cur->m_tls[idx];
+
+    idx -= TLS_SIZE;
+    return idx < cur->m_tlsExtSize ? cur->m_tlsExt[idx] : NULL;
 }
 
 void Thread_base::tlsPut(int32_t idx, void* v)
 {
     assert(current() != 0);
-    current()->m_tls[idx] = v;
+    assert(idx >= 0 && idx < TLS_MAX);
+
+    *current()->tlsSlot(idx) = v;
+}
+
+void** Thread_base::tlsSlot(int32_t idx)
+{
+    if (idx < TLS_SIZE)
+        return &m_tls[idx];
+
+    idx -= TLS_SIZE;
+    if (idx >= m_tlsExtSize) {
+        int32_t sz = m_tlsExtSize ? m_tlsExtSize * 2 : TLS_SIZE;
+        void** ext;
+
+        while (sz <= idx)
+            sz *= 2;
+        if (sz > TLS_MAX - TLS_SIZE)
+            sz = TLS_MAX - TLS_SIZE;
+
+        ext = new void*[sz];
+        if (m_tlsExtSize)
+            memcpy(ext, m_tlsExt, m_tlsExtSize * sizeof(void*));
+        memset(ext + m_tlsExtSize, 0, (sz - m_tlsExtSize) * sizeof(void*));
+
+        delete[] m_tlsExt;
+        m_tlsExt = ext;
+        m_tlsExtSize = sz;
+    }
+
+    return &m_tlsExt[idx];
 }
 
 void Thread_base::tlsFree(int32_t idx)
 {
+    s_tls_lock.lock();
     s_tls[idx] = 0;
     s_tls_free[idx] = NULL;
+    s_tls_lock.unlock();
 }
 
 void Thread_base::destroy()
 {
+    int32_t cnt = s_tls_top;
     int32_t i;
 
-    for (i = 0; i < TLS_SIZE; i++)
-        if (s_tls_free[i]) {
-            s_tls_free[i](m_tls[i]);
-            m_tls[i] = NULL;
+    for (i = 0; i < cnt; i++) {
+        tls_free _free = s_tls_free[i];
+        void** slot;
+
+        if (i < TLS_SIZE)
+            slot = &m_tls[i];
+        else if (i - TLS_SIZE < m_tlsExtSize)
+            slot = &m_tlsExt[i - TLS_SIZE];
+        else
+            break;
+
+        if (_free && *slot) {
+            void* v = *slot;
+
+            *slot = NULL;
+            _free(v);
         }
+    }
+
+    delete[] m_tlsExt;
+    m_tlsExt = NULL;
+    m_tlsExtSize = 0;
 }
 }
@@ -9,8 +9,14 @@
 #include "osconfig.h"
 #include "fb_api.h"
 #include "utils.h"
+#include "service.h"
 #include <string.h>
 
+#ifndef _WIN32
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
 namespace exlib {
 
 #ifdef _WIN32
@@ -25,6 +31,12 @@ void* create_fiber(size_t stacksize, fiber_func proc, void* param)
     return CreateFiber(stacksize, (LPFIBER_START_ROUTINE)proc, param);
 }
 
+void* reset_fiber(void* fiber, size_t stacksize, fiber_func proc, void* param)
+{
+    DeleteFiber(fiber);
+    return CreateFiber(stacksize, (LPFIBER_START_ROUTINE)proc, param);
+}
+
 void switch_fiber(void* from, void* to)
 {
     SwitchToFiber(to);
@@ -35,6 +47,10 @@ void delete_fiber(void* fiber)
     DeleteFiber(fiber);
 }
 
+void set_stack_guard(bool guard)
+{
+}
+
 #else
 
 #define FB_STK_ALIGN 256
@@ -49,6 +65,10 @@ extern "C" void win_switch(void* from, void* to);
 extern "C" void nix_switch(void* from, void* to);
 #define fb_switch nix_switch
 
+#if defined(amd64) || defined(arm64)
+extern "C" void nix_start();
+#endif
+
 #endif
 
 void* convert_Fiber(void* param)
@@ -63,25 +83,297 @@ void* convert_Fiber(void* param)
     return ctx;
 }
 
-void* create_fiber(size_t stacksize, fiber_func proc, void* param)
+#ifndef MAP_ANON
+#define MAP_ANON MAP_ANONYMOUS
+#endif
+
+#ifndef MAP_STACK
+#define MAP_STACK 0
+#endif
+
+#ifndef MAP_NORESERVE
+#define MAP_NORESERVE 0
+#endif
+
+#define FB_STK_BUCKETS 4
+#define FB_STK_LOCAL 16
+#define FB_STK_CACHE 256
+#define FB_STK_COMMIT 32
+#define FB_STK_REGION (16 * 1024 * 1024)
+
+class fiber_stack : public registers {
+public:
+    fiber_stack* m_next;
+    void* m_base;
+    size_t m_size;
+    // m_mapped stacks own their mapping and can be unmapped, the others
+    // are carved from a region shared with other stacks
+    bool m_mapped;
+    bool m_guard;
+};
+
+class stack_bucket {
+public:
+    size_t m_size;
+    fiber_stack* m_committed;
+    fiber_stack* m_released;
+    int32_t m_commit_count;
+    int32_t m_count;
+    char* m_carve;
+    int32_t m_carve_left;
+};
+
+class stack_cache {
+public:
+    stack_cache()
+    {
+        memset(&m_buckets, 0, sizeof(m_buckets));
+    }
+
+public:
+    stack_bucket* get(size_t size, bool create)
+    {
+        int32_t i;
+
+        for (i = 0; i < FB_STK_BUCKETS; i++) {
+            if (m_buckets[i].m_size == size)
+                return &m_buckets[i];
+
+            if (m_buckets[i].m_size == 0) {
+                if (!create)
+                    return NULL;
+
+                m_buckets[i].m_size = size;
+                return &m_buckets[i];
+            }
+        }
+
+        return NULL;
+    }
+
+public:
+    spinlock m_lock;
+
+private:
+    stack_bucket m_buckets[FB_STK_BUCKETS];
+};
+
+static stack_cache s_shared_cache;
+static OSTls s_stack_cache;
+static bool s_guard;
+
+void set_stack_guard(bool guard)
 {
-    stacksize = (stacksize + FB_STK_ALIGN - 1) & ~(FB_STK_ALIGN - 1);
-#ifdef WIN32
-    registers* ctx = (registers*)VirtualAlloc(NULL, stacksize, MEM_COMMIT | MEM_TOP_DOWN, PAGE_READWRITE);
-#else
-    registers* ctx = (registers*)malloc(stacksize);
+    s_guard = guard;
+}
+
+static size_t page_size()
+{
+    static size_t s_page_size;
+
+    if (s_page_size == 0)
+        s_page_size = (size_t)sysconf(_SC_PAGESIZE);
+
+    return s_page_size;
+}
+
+// only workers get a private cache, they live as long as the process
+// and nothing would hand back the stacks cached by other threads
+static stack_cache* local_cache()
+{
+    OSThread* thread_ = OSThread::current();
+
+    if (thread_ == NULL || !thread_->is(Service::type))
+        return NULL;
+
+    stack_cache* cache = (stack_cache*)s_stack_cache;
+
+    if (cache == NULL) {
+        cache = new stack_cache();
+        s_stack_cache = cache;
+    }
+
+    return cache;
+}
+
+static void release_stack(fiber_stack* stk)
+{
+    char* body = (char*)stk->m_base + (stk->m_guard ? page_size() : 0);
+    size_t sz = ((char*)stk - body) & ~(page_size() - 1);
+
+#ifdef MADV_FREE
+    if (madvise(body, sz, MADV_FREE) == 0)
+        return;
 #endif
+    madvise(body, sz, MADV_DONTNEED);
+}
+
+static fiber_stack* place_stack(void* base, size_t size, bool mapped, bool guard)
+{
+    fiber_stack* stk = (fiber_stack*)(((intptr_t)base + size - sizeof(fiber_stack)) & ~(FB_STK_ALIGN - 1));
+
+    stk->m_base = base;
+    stk->m_size = size;
+    stk->m_mapped = mapped;
+    stk->m_guard = guard;
 
-    void** stack = (void**)ctx + stacksize / sizeof(void*) - 6;
+    return stk;
+}
+
+// a stack of its own costs one mapping, two with the guard page, and the
+// kernel caps mappings per process at vm.max_map_count (65530 by default)
+static fiber_stack* map_stack(size_t size, bool guard)
+{
+    void* base = mmap(NULL, size, PROT_READ | PROT_WRITE,
+        MAP_PRIVATE | MAP_ANON | MAP_STACK | MAP_NORESERVE, -1, 0);
+    if (base == MAP_FAILED)
+        return NULL;
+
+    if (guard && mprotect(base, page_size(), PROT_NONE)) {
+        munmap(base, size);
+        return NULL;
+    }
+
+    return place_stack(base, size, true, guard);
+}
+
+// unguarded stacks are cut from regions, one mapping holds many of them
+static fiber_stack* carve_stack(size_t size)
+{
+    int32_t count = (int32_t)(FB_STK_REGION / size);
+    fiber_stack* stk = NULL;
+    stack_bucket* b;
+
+    if (count < 2)
+        return NULL;
+
+    s_shared_cache.m_lock.lock();
+    b = s_shared_cache.get(size, true);
+    if (b) {
+        if (b->m_carve_left == 0) {
+            void* region = mmap(NULL, size * count, PROT_READ | PROT_WRITE,
+                MAP_PRIVATE | MAP_ANON | MAP_STACK | MAP_NORESERVE, -1, 0);
+
+            if (region != MAP_FAILED) {
+                b->m_carve = (char*)region;
+                b->m_carve_left = count;
+            }
+        }
+
+        if (b->m_carve_left > 0) {
+            stk = place_stack(b->m_carve, size, false, false);
+            b->m_carve += size;
+            b->m_carve_left--;
+        }
+    }
+    s_shared_cache.m_lock.unlock();
+
+    return stk;
+}
+
+static fiber_stack* alloc_stack(size_t size)
+{
+    stack_cache* cache = local_cache();
+    stack_bucket* b = cache ? cache->get(size, false) : NULL;
+    fiber_stack* stk = NULL;
+
+    if (b && (stk = b->m_committed) != NULL) {
+        b->m_committed = stk->m_next;
+        b->m_commit_count--;
+        b->m_count--;
+        return stk;
+    }
+
+    s_shared_cache.m_lock.lock();
+    b = s_shared_cache.get(size, false);
+    if (b) {
+        if ((stk = b->m_committed) != NULL) {
+            b->m_committed = stk->m_next;
+            b->m_commit_count--;
+            b->m_count--;
+        } else if ((stk = b->m_released) != NULL) {
+            b->m_released = stk->m_next;
+            b->m_count--;
+        }
+    }
+    s_shared_cache.m_lock.unlock();
+
+    if (stk)
+        return stk;
+
+    if (s_guard && (stk = map_stack(size, true)) != NULL)
+        return stk;
+
+    if ((stk = carve_stack(size)) != NULL)
+        return stk;
+
+    return map_stack(size, false);
+}
+
+static void free_stack(fiber_stack* stk)
+{
+    stack_cache* cache = local_cache();
+    stack_bucket* b = cache ? cache->get(stk->m_size, true) : NULL;
+
+    if (b && b->m_count < FB_STK_LOCAL) {
+        stk->m_next = b->m_committed;
+        b->m_committed = stk;
+        b->m_commit_count++;
+        b->m_count++;
+        return;
+    }
+
+    bool release;
+
+    s_shared_cache.m_lock.lock();
+    b = s_shared_cache.get(stk->m_size, true);
+    release = b && (b->m_commit_count >= FB_STK_COMMIT
+                       || (!stk->m_mapped && b->m_count >= FB_STK_CACHE));
+    s_shared_cache.m_lock.unlock();
+
+    if (release)
+        release_stack(stk);
+
+    // carved stacks can not be unmapped, past the cap they are kept
+    // with their pages given back
+    s_shared_cache.m_lock.lock();
+    if (b && (b->m_count < FB_STK_CACHE || !stk->m_mapped)) {
+        if (release) {
+            stk->m_next = b->m_released;
+            b->m_released = stk;
+        } else {
+            stk->m_next = b->m_committed;
+            b->m_committed = stk;
+            b->m_commit_count++;
+        }
+
+        b->m_count++;
+        stk = NULL;
+    }
+    s_shared_cache.m_lock.unlock();
+
+    if (stk)
+        munmap(stk->m_base, stk->m_size);
+}
+
+static void* init_fiber(fiber_stack* stk, fiber_func proc, void* param)
+{
+    registers* ctx = stk;
+    memset(ctx, 0, sizeof(registers));
+
+    void** stack = (void**)stk - 6;
 
     ctx->sp = (intptr_t)stack;
 
 #if defined(amd64)
-    stack[0] = (void*)proc;
 #ifdef _WIN32
+    stack[0] = (void*)proc;
     ctx->Rcx = (intptr_t)param;
 #else
-    ctx->Rdi = (intptr_t)param;
+    ctx->sp = (intptr_t)(stack + 1);
+    ctx->Rip = (intptr_t)nix_start;
+    ctx->R12 = (intptr_t)proc;
+    ctx->R13 = (intptr_t)param;
 #endif
 #elif defined(i386)
     stack[0] = (void*)proc;
@@ -90,8 +382,9 @@ void* create_fiber(size_t stacksize, fiber_func proc, void* param)
     ctx->lr = (intptr_t)proc;
     ctx->r0 = (intptr_t)param;
 #elif defined(arm64)
-    ctx->lr = (intptr_t)proc;
-    ctx->x0 = (intptr_t)param;
+    ctx->lr = (intptr_t)nix_start;
+    ctx->x19 = (intptr_t)proc;
+    ctx->x20 = (intptr_t)param;
 #elif defined(mips)
     ctx->ra = (intptr_t)proc;
     ctx->a0 = (intptr_t)param;
@@ -103,6 +396,26 @@ void* create_fiber(size_t stacksize, fiber_func proc, void* param)
     return ctx;
 }
 
+void* create_fiber(size_t stacksize, fiber_func proc, void* param)
+{
+    size_t page = page_size();
+
+    stacksize = (stacksize + page - 1) & ~(page - 1);
+    if (s_guard)
+        stacksize += page;
+
+    fiber_stack* stk = alloc_stack(stacksize);
+    if (stk == NULL)
+        return NULL;
+
+    return init_fiber(stk, proc, param);
+}
+
+void* reset_fiber(void* fiber, size_t stacksize, fiber_func proc, void* param)
+{
+    return init_fiber((fiber_stack*)fiber, proc, param);
+}
+
 void switch_fiber(void* from, void* to)
 {
     fb_switch(from, to);
@@ -110,11 +423,7 @@ void switch_fiber(void* from, void* to)
 
 void delete_fiber(void* fiber)
 {
-#ifdef WIN32
-    VirtualFree(fiber, 0, MEM_RELEASE);
-#else
-    free(fiber);
-#endif
+    free_stack((fiber_stack*)fiber);
 }
 
 #endif
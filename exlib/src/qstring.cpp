@@ -0,0 +1,596 @@
+/*
+ *  qstring.cpp
+ *  Created on: Oct 17, 2026
+ *
+ *  Copyright (c) 2026 by Leo Hoo
+ *  lion@9465.net
+ */
+
+#include "osconfig.h"
+#include "qstring.h"
+
+#if defined(amd64) || defined(i386)
+#define SIMD_X86
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#include <immintrin.h>
+#elif defined(arm64)
+#define SIMD_NEON
+#include <arm_neon.h>
+#endif
+
+#ifdef _MSC_VER
+#define SIMD_TARGET(x)
+#else
+#define SIMD_TARGET(x) __attribute__((target(x)))
+#endif
+
+namespace exlib {
+
+static inline int32_t ctz32(uint32_t v)
+{
+#ifdef _MSC_VER
+    unsigned long i;
+    _BitScanForward(&i, v);
+    return (int32_t)i;
+#else
+    return __builtin_ctz(v);
+#endif
+}
+
+// portable kernels, also used for the tails the vector loops leave over.
+// fold flips the case of every letter in [base, base + 25], so 'A' lowers
+// and 'a' uppers.
+
+static const char* find_scalar(const char* s1, size_t sz1, const char* s2, size_t sz2)
+{
+    const char* end;
+
+    if (sz1 < sz2)
+        return NULL;
+
+    end = s1 + (sz1 - sz2 + 1);
+    while (s1 < end) {
+        s1 = (const char*)memchr(s1, s2[0], end - s1);
+        if (s1 == NULL)
+            return NULL;
+
+        if (memcmp(s1 + 1, s2 + 1, sz2 - 1) == 0)
+            return s1;
+        s1++;
+    }
+
+    return NULL;
+}
+
+static int32_t icmp_scalar(const char* s1, const char* s2, size_t count)
+{
+    int32_t n;
+
+    while (count--) {
+        n = (uint8_t)qtolower(*s1++) - (uint8_t)qtolower(*s2++);
+        if (n != 0)
+            return n;
+    }
+
+    return 0;
+}
+
+static void fold_scalar(char* ptr, size_t num, char base)
+{
+    while (num--) {
+        if ((uint8_t)(*ptr - base) < 26)
+            *ptr ^= 0x20;
+        ptr++;
+    }
+}
+
+static size_t wcslen_scalar(const wchar* str)
+{
+    const wchar* p;
+
+    for (p = str; *p != 0; p++)
+        continue;
+
+    return p - str;
+}
+
+static void wfold_scalar(wchar* ptr, size_t num, wchar base)
+{
+    while (num--) {
+        if ((uint16_t)(*ptr - base) < 26)
+            *ptr ^= 0x20;
+        ptr++;
+    }
+}
+
+#ifdef SIMD_X86
+
+// the first and last byte of the needle filter candidate positions a
+// whole register at a time, only those are compared in full
+
+SIMD_TARGET("sse2")
+static const char* find_sse2(const char* s1, size_t sz1, const char* s2, size_t sz2)
+{
+    const __m128i first = _mm_set1_epi8(s2[0]);
+    const __m128i last = _mm_set1_epi8(s2[sz2 - 1]);
+    size_t i;
+
+    for (i = 0; i + sz2 + 15 <= sz1; i += 16) {
+        __m128i a = _mm_loadu_si128((const __m128i*)(s1 + i));
+        __m128i b = _mm_loadu_si128((const __m128i*)(s1 + i + sz2 - 1));
+        uint32_t mask = _mm_movemask_epi8(_mm_and_si128(_mm_cmpeq_epi8(a, first),
+            _mm_cmpeq_epi8(b, last)));
+
+        while (mask) {
+            size_t pos = i + ctz32(mask);
+
+            if (memcmp(s1 + pos + 1, s2 + 1, sz2 - 2) == 0)
+                return s1 + pos;
+            mask &= mask - 1;
+        }
+    }
+
+    return find_scalar(s1 + i, sz1 - i, s2, sz2);
+}
+
+SIMD_TARGET("sse2")
+static inline __m128i fold_sse2(__m128i x, char base)
+{
+    __m128i t = _mm_add_epi8(x, _mm_set1_epi8((char)(0x80 - base)));
+    __m128i m = _mm_cmplt_epi8(t, _mm_set1_epi8((char)(0x80 + 26)));
+
+    return _mm_xor_si128(x, _mm_and_si128(m, _mm_set1_epi8(0x20)));
+}
+
+SIMD_TARGET("sse2")
+static int32_t icmp_sse2(const char* s1, const char* s2, size_t count)
+{
+    size_t i;
+
+    for (i = 0; i + 16 <= count; i += 16) {
+        __m128i a = fold_sse2(_mm_loadu_si128((const __m128i*)(s1 + i)), 'A');
+        __m128i b = fold_sse2(_mm_loadu_si128((const __m128i*)(s2 + i)), 'A');
+        uint32_t mask = _mm_movemask_epi8(_mm_cmpeq_epi8(a, b)) ^ 0xffff;
+
+        if (mask) {
+            i += ctz32(mask);
+            return (uint8_t)qtolower(s1[i]) - (uint8_t)qtolower(s2[i]);
+        }
+    }
+
+    return icmp_scalar(s1 + i, s2 + i, count - i);
+}
+
+SIMD_TARGET("sse2")
+static void fold_sse2(char* ptr, size_t num, char base)
+{
+    for (; num >= 16; ptr += 16, num -= 16)
+        _mm_storeu_si128((__m128i*)ptr, fold_sse2(_mm_loadu_si128((const __m128i*)ptr), base));
+
+    fold_scalar(ptr, num, base);
+}
+
+// aligned loads never cross into a page the string does not touch
+SIMD_TARGET("sse2")
+static size_t wcslen_sse2(const wchar* str)
+{
+    const __m128i zero = _mm_setzero_si128();
+    const wchar* p = str;
+    uint32_t mask;
+
+    while ((intptr_t)p & 15) {
+        if (*p == 0)
+            return p - str;
+        p++;
+    }
+
+    while (!(mask = _mm_movemask_epi8(_mm_cmpeq_epi16(_mm_load_si128((const __m128i*)p), zero))))
+        p += 8;
+
+    return p - str + (ctz32(mask) >> 1);
+}
+
+SIMD_TARGET("sse2")
+static void wfold_sse2(wchar* ptr, size_t num, wchar base)
+{
+    const __m128i bias = _mm_set1_epi16((int16_t)(0x8000 - base));
+    const __m128i limit = _mm_set1_epi16((int16_t)(0x8000 + 26));
+    const __m128i bit = _mm_set1_epi16(0x20);
+
+    for (; num >= 8; ptr += 8, num -= 8) {
+        __m128i x = _mm_loadu_si128((const __m128i*)ptr);
+        __m128i m = _mm_cmplt_epi16(_mm_add_epi16(x, bias), limit);
+
+        _mm_storeu_si128((__m128i*)ptr, _mm_xor_si128(x, _mm_and_si128(m, bit)));
+    }
+
+    wfold_scalar(ptr, num, base);
+}
+
+SIMD_TARGET("avx2")
+static const char* find_avx2(const char* s1, size_t sz1, const char* s2, size_t sz2)
+{
+    const __m256i first = _mm256_set1_epi8(s2[0]);
+    const __m256i last = _mm256_set1_epi8(s2[sz2 - 1]);
+    size_t i;
+
+    for (i = 0; i + sz2 + 31 <= sz1; i += 32) {
+        __m256i a = _mm256_loadu_si256((const __m256i*)(s1 + i));
+        __m256i b = _mm256_loadu_si256((const __m256i*)(s1 + i + sz2 - 1));
+        uint32_t mask = _mm256_movemask_epi8(_mm256_and_si256(_mm256_cmpeq_epi8(a, first),
+            _mm256_cmpeq_epi8(b, last)));
+
+        while (mask) {
+            size_t pos = i + ctz32(mask);
+
+            if (memcmp(s1 + pos + 1, s2 + 1, sz2 - 2) == 0)
+                return s1 + pos;
+            mask &= mask - 1;
+        }
+    }
+
+    return find_sse2(s1 + i, sz1 - i, s2, sz2);
+}
+
+SIMD_TARGET("avx2")
+static inline __m256i fold_avx2(__m256i x, char base)
+{
+    __m256i t = _mm256_add_epi8(x, _mm256_set1_epi8((char)(0x80 - base)));
+    __m256i m = _mm256_cmpgt_epi8(_mm256_set1_epi8((char)(0x80 + 26)), t);
+
+    return _mm256_xor_si256(x, _mm256_and_si256(m, _mm256_set1_epi8(0x20)));
+}
+
+SIMD_TARGET("avx2")
+static int32_t icmp_avx2(const char* s1, const char* s2, size_t count)
+{
+    size_t i;
+
+    for (i = 0; i + 32 <= count; i += 32) {
+        __m256i a = fold_avx2(_mm256_loadu_si256((const __m256i*)(s1 + i)), 'A');
+        __m256i b = fold_avx2(_mm256_loadu_si256((const __m256i*)(s2 + i)), 'A');
+        uint32_t mask = ~(uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(a, b));
+
+        if (mask) {
+            i += ctz32(mask);
+            return (uint8_t)qtolower(s1[i]) - (uint8_t)qtolower(s2[i]);
+        }
+    }
+
+    return icmp_sse2(s1 + i, s2 + i, count - i);
+}
+
+SIMD_TARGET("avx2")
+static void fold_avx2(char* ptr, size_t num, char base)
+{
+    for (; num >= 32; ptr += 32, num -= 32)
+        _mm256_storeu_si256((__m256i*)ptr, fold_avx2(_mm256_loadu_si256((const __m256i*)ptr), base));
+
+    fold_sse2(ptr, num, base);
+}
+
+SIMD_TARGET("avx2")
+static size_t wcslen_avx2(const wchar* str)
+{
+    const __m256i zero = _mm256_setzero_si256();
+    const wchar* p = str;
+    uint32_t mask;
+
+    while ((intptr_t)p & 31) {
+        if (*p == 0)
+            return p - str;
+        p++;
+    }
+
+    while (!(mask = _mm256_movemask_epi8(_mm256_cmpeq_epi16(_mm256_load_si256((const __m256i*)p), zero))))
+        p += 16;
+
+    return p - str + (ctz32(mask) >> 1);
+}
+
+SIMD_TARGET("avx2")
+static void wfold_avx2(wchar* ptr, size_t num, wchar base)
+{
+    const __m256i bias = _mm256_set1_epi16((int16_t)(0x8000 - base));
+    const __m256i limit = _mm256_set1_epi16((int16_t)(0x8000 + 26));
+    const __m256i bit = _mm256_set1_epi16(0x20);
+
+    for (; num >= 16; ptr += 16, num -= 16) {
+        __m256i x = _mm256_loadu_si256((const __m256i*)ptr);
+        __m256i m = _mm256_cmpgt_epi16(limit, _mm256_add_epi16(x, bias));
+
+        _mm256_storeu_si256((__m256i*)ptr, _mm256_xor_si256(x, _mm256_and_si256(m, bit)));
+    }
+
+    wfold_sse2(ptr, num, base);
+}
+
+static int32_t x86_level()
+{
+#ifdef _MSC_VER
+    int32_t info[4];
+    int32_t max;
+    bool avx;
+
+    __cpuid(info, 0);
+    max = info[0];
+
+    __cpuid(info, 1);
+    if (!(info[3] & (1 << 26)))
+        return 0;
+
+    // avx state has to be enabled by the os as well
+    avx = (info[2] & (1 << 27)) && (info[2] & (1 << 28)) && (_xgetbv(0) & 6) == 6;
+    if (avx && max >= 7) {
+        __cpuidex(info, 7, 0);
+        if (info[1] & (1 << 5))
+            return 2;
+    }
+
+    return 1;
+#else
+    __builtin_cpu_init();
+
+    if (__builtin_cpu_supports("avx2"))
+        return 2;
+    if (__builtin_cpu_supports("sse2"))
+        return 1;
+    return 0;
+#endif
+}
+
+#endif
+
+#ifdef SIMD_NEON
+
+// one bit per byte lane, at bit 4 * lane + 3
+static inline uint64_t neon_mask(uint8x16_t m)
+{
+    uint8x8_t n = vshrn_n_u16(vreinterpretq_u16_u8(m), 4);
+    return vget_lane_u64(vreinterpret_u64_u8(n), 0) & 0x8888888888888888ull;
+}
+
+static const char* find_neon(const char* s1, size_t sz1, const char* s2, size_t sz2)
+{
+    const uint8x16_t first = vdupq_n_u8(s2[0]);
+    const uint8x16_t last = vdupq_n_u8(s2[sz2 - 1]);
+    size_t i;
+
+    for (i = 0; i + sz2 + 15 <= sz1; i += 16) {
+        uint8x16_t a = vld1q_u8((const uint8_t*)(s1 + i));
+        uint8x16_t b = vld1q_u8((const uint8_t*)(s1 + i + sz2 - 1));
+        uint64_t mask = neon_mask(vandq_u8(vceqq_u8(a, first), vceqq_u8(b, last)));
+
+        while (mask) {
+            size_t pos = i + (__builtin_ctzll(mask) >> 2);
+
+            if (memcmp(s1 + pos + 1, s2 + 1, sz2 - 2) == 0)
+                return s1 + pos;
+            mask &= mask - 1;
+        }
+    }
+
+    return find_scalar(s1 + i, sz1 - i, s2, sz2);
+}
+
+static inline uint8x16_t fold_neon(uint8x16_t x, char base)
+{
+    uint8x16_t m = vcltq_u8(vsubq_u8(x, vdupq_n_u8(base)), vdupq_n_u8(26));
+    return veorq_u8(x, vandq_u8(m, vdupq_n_u8(0x20)));
+}
+
+static int32_t icmp_neon(const char* s1, const char* s2, size_t count)
+{
+    size_t i;
+
+    for (i = 0; i + 16 <= count; i += 16) {
+        uint8x16_t a = fold_neon(vld1q_u8((const uint8_t*)(s1 + i)), 'A');
+        uint8x16_t b = fold_neon(vld1q_u8((const uint8_t*)(s2 + i)), 'A');
+        uint64_t mask = neon_mask(vmvnq_u8(vceqq_u8(a, b)));
+
+        if (mask) {
+            i += __builtin_ctzll(mask) >> 2;
+            return (uint8_t)qtolower(s1[i]) - (uint8_t)qtolower(s2[i]);
+        }
+    }
+
+    return icmp_scalar(s1 + i, s2 + i, count - i);
+}
+
+static void fold_neon(char* ptr, size_t num, char base)
+{
+    for (; num >= 16; ptr += 16, num -= 16)
+        vst1q_u8((uint8_t*)ptr, fold_neon(vld1q_u8((const uint8_t*)ptr), base));
+
+    fold_scalar(ptr, num, base);
+}
+
+static size_t wcslen_neon(const wchar* str)
+{
+    const wchar* p = str;
+    uint16x8_t m;
+
+    while ((intptr_t)p & 15) {
+        if (*p == 0)
+            return p - str;
+        p++;
+    }
+
+    while (!vmaxvq_u16(m = vceqzq_u16(vld1q_u16((const uint16_t*)p))))
+        p += 8;
+
+    uint64_t mask = vget_lane_u64(vreinterpret_u64_u8(vmovn_u16(m)), 0);
+    return p - str + (__builtin_ctzll(mask) >> 3);
+}
+
+static void wfold_neon(wchar* ptr, size_t num, wchar base)
+{
+    const uint16x8_t vbase = vdupq_n_u16(base);
+    const uint16x8_t limit = vdupq_n_u16(26);
+    const uint16x8_t bit = vdupq_n_u16(0x20);
+
+    for (; num >= 8; ptr += 8, num -= 8) {
+        uint16x8_t x = vld1q_u16((const uint16_t*)ptr);
+        uint16x8_t m = vcltq_u16(vsubq_u16(x, vbase), limit);
+
+        vst1q_u16((uint16_t*)ptr, veorq_u16(x, vandq_u16(m, bit)));
+    }
+
+    wfold_scalar(ptr, num, base);
+}
+
+#endif
+
+// every entry starts at a stub that picks the kernels on first use, so
+// the table is usable from static constructors in other files
+
+static void select_kernels();
+
+static const char* find_init(const char* s1, size_t sz1, const char* s2, size_t sz2);
+static int32_t icmp_init(const char* s1, const char* s2, size_t count);
+static void fold_init(char* ptr, size_t num, char base);
+static size_t wcslen_init(const wchar* str);
+static void wfold_init(wchar* ptr, size_t num, wchar base);
+
+static const char* (*s_find)(const char* s1, size_t sz1, const char* s2, size_t sz2) = find_init;
+static int32_t (*s_icmp)(const char* s1, const char* s2, size_t count) = icmp_init;
+static void (*s_fold)(char* ptr, size_t num, char base) = fold_init;
+static size_t (*s_wcslen)(const wchar* str) = wcslen_init;
+static void (*s_wfold)(wchar* ptr, size_t num, wchar base) = wfold_init;
+
+static bool set_kernels(int32_t kernels)
+{
+    switch (kernels) {
+    case QSTR_SCALAR:
+        s_find = find_scalar;
+        s_icmp = icmp_scalar;
+        s_fold = fold_scalar;
+        s_wcslen = wcslen_scalar;
+        s_wfold = wfold_scalar;
+        return true;
+#if defined(SIMD_X86)
+    case QSTR_SSE2:
+        if (x86_level() < 1)
+            return false;
+        s_find = find_sse2;
+        s_icmp = icmp_sse2;
+        s_fold = fold_sse2;
+        s_wcslen = wcslen_sse2;
+        s_wfold = wfold_sse2;
+        return true;
+    case QSTR_AVX2:
+        if (x86_level() < 2)
+            return false;
+        s_find = find_avx2;
+        s_icmp = icmp_avx2;
+        s_fold = fold_avx2;
+        s_wcslen = wcslen_avx2;
+        s_wfold = wfold_avx2;
+        return true;
+#elif defined(SIMD_NEON)
+    case QSTR_NEON:
+        s_find = find_neon;
+        s_icmp = icmp_neon;
+        s_fold = fold_neon;
+        s_wcslen = wcslen_neon;
+        s_wfold = wfold_neon;
+        return true;
+#endif
+    }
+
+    return false;
+}
+
+static void select_kernels()
+{
+    if (!set_kernels(QSTR_AVX2) && !set_kernels(QSTR_SSE2) && !set_kernels(QSTR_NEON))
+        set_kernels(QSTR_SCALAR);
+}
+
+bool qstr_kernels(int32_t kernels)
+{
+    if (kernels == QSTR_AUTO) {
+        select_kernels();
+        return true;
+    }
+
+    return set_kernels(kernels);
+}
+
+static const char* find_init(const char* s1, size_t sz1, const char* s2, size_t sz2)
+{
+    select_kernels();
+    return s_find(s1, sz1, s2, sz2);
+}
+
+static int32_t icmp_init(const char* s1, const char* s2, size_t count)
+{
+    select_kernels();
+    return s_icmp(s1, s2, count);
+}
+
+static void fold_init(char* ptr, size_t num, char base)
+{
+    select_kernels();
+    s_fold(ptr, num, base);
+}
+
+static size_t wcslen_init(const wchar* str)
+{
+    select_kernels();
+    return s_wcslen(str);
+}
+
+static void wfold_init(wchar* ptr, size_t num, wchar base)
+{
+    select_kernels();
+    s_wfold(ptr, num, base);
+}
+
+const char* qmemfind(const char* s1, size_t sz1, const char* s2, size_t sz2)
+{
+    if (sz2 > sz1)
+        return NULL;
+    if (sz2 == 0)
+        return s1;
+    if (sz2 == 1)
+        return (const char*)memchr(s1, s2[0], sz1);
+
+    return s_find(s1, sz1, s2, sz2);
+}
+
+int32_t qmemicmp(const char* s1, const char* s2, size_t count)
+{
+    if (s1 == s2)
+        return 0;
+
+    return s_icmp(s1, s2, count);
+}
+
+void qmemlower(char* ptr, size_t num)
+{
+    s_fold(ptr, num, 'A');
+}
+
+void qmemupper(char* ptr, size_t num)
+{
+    s_fold(ptr, num, 'a');
+}
+
+size_t qstrlen(const wchar* pStr)
+{
+    return s_wcslen(pStr);
+}
+
+void qmemlower(wchar* ptr, size_t num)
+{
+    s_wfold(ptr, num, 'A');
+}
+
+void qmemupper(wchar* ptr, size_t num)
+{
+    s_wfold(ptr, num, 'a');
+}
+}
@@ -16,6 +16,11 @@
 #ifndef _WIN32
 #include <cxxabi.h>
 #include <dlfcn.h>
+#ifdef Linux
+#include <time.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+#endif
 #else
 #include <process.h>
 #endif
@@ -24,10 +29,101 @@ namespace exlib {
 
 OSTls th_current;
 
+void affinity_unbind();
+
+#ifdef Linux
+
+static int32_t cpu_count()
+{
+    static int32_t s_cpus;
+
+    if (s_cpus == 0) {
+        long n = sysconf(_SC_NPROCESSORS_ONLN);
+        s_cpus = n > 0 ? (int32_t)n : 1;
+    }
+
+    return s_cpus;
+}
+
+bool OSSemaphore::TrySpin()
+{
+    if (TryWait())
+        return true;
+
+    if (cpu_count() < 2)
+        return false;
+
+    int32_t limit = m_spin * 2;
+    int32_t i;
+
+    if (limit > SPIN_MAX)
+        limit = SPIN_MAX;
+
+    for (i = 0; i < limit; i++) {
+        exlib::yield();
+        if (m_count > 0 && TryWait()) {
+            m_spin += (i - m_spin) / 8;
+            if (m_spin < SPIN_MIN)
+                m_spin = SPIN_MIN;
+            return true;
+        }
+    }
+
+    m_spin += (limit - m_spin) / 8;
+    if (m_spin > SPIN_MAX / 2)
+        m_spin = SPIN_MAX / 2;
+
+    return false;
+}
+
+bool OSSemaphore::WaitSlow(int64_t us)
+{
+    struct timespec now, deadline, rel;
+    struct timespec* pts = NULL;
+    bool ok = false;
+
+    if (us >= 0) {
+        clock_gettime(CLOCK_MONOTONIC, &deadline);
+        int64_t ns = deadline.tv_nsec + (us % 1000000) * 1000;
+        deadline.tv_sec += (time_t)(us / 1000000 + ns / 1000000000);
+        deadline.tv_nsec = (long)(ns % 1000000000);
+        pts = &rel;
+    }
+
+    atom_inc(&m_waiters);
+
+    while (!(ok = TryWait())) {
+        if (pts) {
+            clock_gettime(CLOCK_MONOTONIC, &now);
+            rel.tv_sec = deadline.tv_sec - now.tv_sec;
+            rel.tv_nsec = deadline.tv_nsec - now.tv_nsec;
+            if (rel.tv_nsec < 0) {
+                rel.tv_nsec += 1000000000;
+                rel.tv_sec--;
+            }
+            if (rel.tv_sec < 0)
+                break;
+        }
+
+        syscall(SYS_futex, &m_count, FUTEX_WAIT_PRIVATE, 0, pts, NULL, 0);
+    }
+
+    atom_dec(&m_waiters);
+    return ok;
+}
+
+void OSSemaphore::wake()
+{
+    syscall(SYS_futex, &m_count, FUTEX_WAKE_PRIVATE, 1, NULL, NULL, 0);
+}
+
+#endif
+
 void* OSThread::Entry(void* arg)
 {
     OSThread* thread = reinterpret_cast<OSThread*>(arg);
     thread->saveStackGuard();
+    affinity_unbind();
 
     th_current = thread;
     thread->Run();
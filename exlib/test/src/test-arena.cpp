@@ -0,0 +1,157 @@
+/*
+ *  test-arena.cpp
+ *  Created on: Oct 17, 2026
+ *
+ *  Copyright (c) 2026 by Leo Hoo
+ *  lion@9465.net
+ */
+
+#include "gtest/gtest.h"
+#include "exlib/include/service.h"
+#include "exlib/include/arena.h"
+#include <vector>
+#include <thread>
+
+using namespace exlib;
+
+TEST(arena, bump)
+{
+    Arena a;
+    char* p1 = (char*)a.alloc(10);
+    char* p2 = (char*)a.alloc(10);
+    int64_t* p3 = a.alloc<int64_t>(3);
+
+    EXPECT_EQ(p1 + 16, p2);
+    EXPECT_EQ(0, (intptr_t)p3 & (intptr_t)(alignof(int64_t) - 1));
+    EXPECT_EQ(p2 + 16, (char*)p3);
+}
+
+// a large block that does not fit gets a chunk of its own, the small ones
+// keep bumping the chunk they were in, and the mark brings back exactly
+// that position
+TEST(arena, reset_after_large)
+{
+    Arena a;
+    char* p1 = (char*)a.alloc(16);
+    Arena::Mark m = a.mark();
+    char* p2 = (char*)a.alloc(16);
+    char* big = (char*)a.alloc(Arena::CHUNK_SIZE);
+    char* p3 = (char*)a.alloc(16);
+
+    EXPECT_EQ(p1 + 16, p2);
+    EXPECT_EQ(p2 + 16, p3);
+    EXPECT_TRUE(big < p1 || big > p1 + Arena::CHUNK_SIZE);
+    memset(big, 0x5a, Arena::CHUNK_SIZE);
+
+    a.reset(m);
+    EXPECT_EQ(p2, (char*)a.alloc(16));
+
+    Arena::Mark m1 = a.mark();
+    EXPECT_EQ(m.m_chunk, m1.m_chunk);
+    EXPECT_EQ(m.m_pos + 16, m1.m_pos);
+    EXPECT_EQ(m.m_end, m1.m_end);
+}
+
+// nothing to bump yet when the large block comes first, the small block
+// after it opens the first chunk
+TEST(arena, large_first)
+{
+    Arena a;
+    Arena::Mark m = a.mark();
+    char* big = (char*)a.alloc(Arena::CHUNK_SIZE * 2);
+    char* p1 = (char*)a.alloc(16);
+    char* p2 = (char*)a.alloc(16);
+
+    memset(big, 0x5a, Arena::CHUNK_SIZE * 2);
+    EXPECT_EQ(p1 + 16, p2);
+
+    a.reset(m);
+
+    Arena::Mark m1 = a.mark();
+    EXPECT_TRUE(m1.m_chunk == NULL);
+    EXPECT_EQ(0, m1.m_pos);
+    EXPECT_EQ(0, m1.m_end);
+}
+
+TEST(arena, nested_scope)
+{
+    Arena* a = Arena::current();
+    ASSERT_TRUE(a != NULL);
+
+    char* p1;
+    char* p2;
+
+    {
+        Arena::Scope s;
+
+        p1 = (char*)a->alloc(16);
+        {
+            Arena::Scope s1;
+            int32_t i;
+
+            p2 = (char*)a->alloc(16);
+            for (i = 0; i < 10; i++)
+                a->alloc(i & 1 ? Arena::CHUNK_SIZE / 3 : Arena::LARGE_SIZE - 8);
+        }
+
+        EXPECT_EQ(p2, (char*)a->alloc(16));
+    }
+
+    EXPECT_EQ(p1, (char*)a->alloc(16));
+    a->reset();
+}
+
+// uses up the chunk being bumped without starting a new one
+static void fill(Arena& a)
+{
+    Arena::Mark m;
+
+    while ((m = a.mark()).m_end > m.m_pos) {
+        size_t left = (size_t)(m.m_end - m.m_pos);
+        a.alloc(left < 1024 ? left : 1024, 1);
+    }
+}
+
+// chunks given back on a worker go to its cache, the next arena that grows
+// there takes them before asking malloc, in the order they were opened
+TEST(arena, chunk_reuse)
+{
+    Arena a;
+    std::vector<char*> chunks;
+    int32_t i;
+
+    for (i = 0; i < 4; i++) {
+        chunks.push_back((char*)a.alloc(16));
+        fill(a);
+    }
+    a.reset();
+
+    Arena b;
+
+    for (i = 0; i < 4; i++) {
+        EXPECT_EQ(chunks[i], (char*)b.alloc(16));
+        fill(b);
+    }
+}
+
+static void foreign_proc(Arena** current, void** block)
+{
+    Arena a;
+    Arena::Scope s(a);
+
+    *current = Arena::current();
+    *block = a.alloc(16);
+}
+
+// threads exlib did not start have no current arena, an explicit one works
+TEST(arena, foreign_thread)
+{
+    Arena* current = (Arena*)1;
+    void* block = NULL;
+
+    std::thread th(foreign_proc, &current, &block);
+    th.join();
+
+    EXPECT_TRUE(current == NULL);
+    EXPECT_TRUE(block != NULL);
+}
@@ -0,0 +1,236 @@
+/*
+ *  test-qstring.cpp
+ *  Created on: Oct 17, 2026
+ *
+ *  Copyright (c) 2026 by Leo Hoo
+ *  lion@9465.net
+ */
+
+#include "gtest/gtest.h"
+#include "exlib/include/qstring.h"
+
+using namespace exlib;
+
+#define MAX_LEN 80
+#define MAX_OFFSET 32
+#define GUARD 64
+
+static const int32_t s_kernels[] = { QSTR_SCALAR, QSTR_SSE2, QSTR_AVX2, QSTR_NEON };
+static const char* s_names[] = { "scalar", "sse2", "avx2", "neon" };
+
+static uint32_t s_seed;
+
+static uint32_t next_rand()
+{
+    s_seed = s_seed * 1103515245 + 12345;
+    return s_seed >> 8;
+}
+
+// letters of both cases, their neighbours around the fold range and high bytes
+static char rand_char()
+{
+    static const char pool[] = "AaZzMm@[`{09 \x80\xc1\xe1\xff";
+    uint32_t r = next_rand();
+
+    if (r & 1)
+        return pool[(r >> 1) % (sizeof(pool) - 1)];
+    return (char)(r >> 1);
+}
+
+static const char* ref_find(const char* s1, size_t sz1, const char* s2, size_t sz2)
+{
+    size_t i;
+
+    for (i = 0; i + sz2 <= sz1; i++)
+        if (memcmp(s1 + i, s2, sz2) == 0)
+            return s1 + i;
+
+    return NULL;
+}
+
+static int32_t ref_icmp(const char* s1, const char* s2, size_t count)
+{
+    size_t i;
+
+    for (i = 0; i < count; i++) {
+        int32_t n = (uint8_t)qtolower(s1[i]) - (uint8_t)qtolower(s2[i]);
+        if (n != 0)
+            return n;
+    }
+
+    return 0;
+}
+
+// runs body once per kernel set this build and cpu can run
+#define FOR_EACH_KERNEL(body)                                                  \
+    for (int32_t k = 0; k < (int32_t)(sizeof(s_kernels) / sizeof(s_kernels[0])); k++) { \
+        if (!qstr_kernels(s_kernels[k]))                                       \
+            continue;                                                          \
+        SCOPED_TRACE(s_names[k]);                                              \
+        body;                                                                  \
+    }                                                                          \
+    qstr_kernels(QSTR_AUTO);
+
+static void check_find()
+{
+    static const size_t needles[] = { 2, 3, 7, 15, 16, 17, 31, 32, 33 };
+    char buf[MAX_OFFSET + MAX_LEN + GUARD];
+    char needle[MAX_LEN];
+    size_t len, off, n, m, pos;
+
+    s_seed = 1;
+    for (len = 0; len <= MAX_LEN; len++)
+        for (off = 0; off < MAX_OFFSET; off += 3)
+            for (n = 0; n < sizeof(needles) / sizeof(needles[0]) && needles[n] <= len; n++) {
+                size_t sz2 = needles[n];
+
+                for (pos = 0; pos < sizeof(buf); pos++)
+                    buf[pos] = "ab"[next_rand() & 1];
+
+                // the match lands at the start, in the middle and in the tail
+                for (m = 0; m < 3; m++) {
+                    char* s1 = buf + off;
+                    size_t i;
+
+                    pos = (len - sz2) * m / 2;
+
+                    for (i = 0; i < sz2; i++)
+                        needle[i] = rand_char();
+                    memcpy(s1 + pos, needle, sz2);
+
+                    EXPECT_EQ(ref_find(s1, len, needle, sz2), qmemfind(s1, len, needle, sz2))
+                        << "len " << len << " off " << off << " needle " << sz2 << " at " << pos;
+                }
+
+                // only the last byte of the needle differs
+                memcpy(needle, buf + off, sz2);
+                needle[sz2 - 1] = 'c';
+                EXPECT_EQ(ref_find(buf + off, len, needle, sz2), qmemfind(buf + off, len, needle, sz2));
+            }
+}
+
+static void check_icmp()
+{
+    char b1[MAX_OFFSET + MAX_LEN + GUARD];
+    char b2[MAX_OFFSET + MAX_LEN + GUARD];
+    size_t len, off, pos, i;
+
+    s_seed = 2;
+    for (len = 0; len <= MAX_LEN; len++)
+        for (off = 0; off < MAX_OFFSET; off++) {
+            char* s1 = b1 + off;
+            char* s2 = b2 + (MAX_OFFSET - 1 - off);
+
+            for (i = 0; i < len; i++) {
+                s1[i] = rand_char();
+                s2[i] = qisupper(s1[i]) ? qtolower(s1[i]) : qtoupper(s1[i]);
+            }
+
+            EXPECT_EQ(0, qmemicmp(s1, s2, len)) << "len " << len << " off " << off;
+
+            for (pos = 0; pos < len; pos++) {
+                char save = s2[pos];
+
+                s2[pos] = rand_char();
+                EXPECT_EQ(ref_icmp(s1, s2, len), qmemicmp(s1, s2, len))
+                    << "len " << len << " off " << off << " diff at " << pos;
+                s2[pos] = save;
+            }
+        }
+}
+
+static void check_fold()
+{
+    char buf[MAX_OFFSET + MAX_LEN + GUARD];
+    char ref[MAX_OFFSET + MAX_LEN + GUARD];
+    size_t len, off, i;
+
+    s_seed = 3;
+    for (len = 0; len <= MAX_LEN; len++)
+        for (off = 0; off < MAX_OFFSET; off++) {
+            for (i = 0; i < sizeof(buf); i++)
+                buf[i] = rand_char();
+
+            memcpy(ref, buf, sizeof(buf));
+            for (i = 0; i < len; i++)
+                ref[off + i] = qtolower(ref[off + i]);
+            qmemlower(buf + off, len);
+            EXPECT_EQ(0, memcmp(ref, buf, sizeof(buf))) << "lower len " << len << " off " << off;
+
+            for (i = 0; i < len; i++)
+                ref[off + i] = qtoupper(ref[off + i]);
+            qmemupper(buf + off, len);
+            EXPECT_EQ(0, memcmp(ref, buf, sizeof(buf))) << "upper len " << len << " off " << off;
+        }
+}
+
+static wchar rand_wchar()
+{
+    static const wchar pool[] = { 'A', 'a', 'Z', 'z', '@', '[', '`', '{',
+        0x80, 0xc1, 0xe1, 0x141, 0x161, 0x8041, 0xff41, 0xffff };
+    uint32_t r = next_rand();
+
+    if (r & 1)
+        return pool[(r >> 1) % (sizeof(pool) / sizeof(pool[0]))];
+    return (wchar)(r >> 1);
+}
+
+static void check_wide()
+{
+    wchar buf[MAX_OFFSET + MAX_LEN + GUARD];
+    wchar ref[MAX_OFFSET + MAX_LEN + GUARD];
+    size_t len, off, i;
+
+    s_seed = 4;
+    for (len = 0; len <= MAX_LEN; len++)
+        for (off = 0; off < MAX_OFFSET; off++) {
+            for (i = 0; i < sizeof(buf) / sizeof(wchar); i++) {
+                wchar c;
+
+                while ((c = rand_wchar()) == 0)
+                    ;
+                buf[i] = c;
+            }
+            buf[off + len] = 0;
+
+            EXPECT_EQ(len, qstrlen((const wchar*)buf + off)) << "len " << len << " off " << off;
+
+            memcpy(ref, buf, sizeof(buf));
+            for (i = 0; i < len; i++)
+                ref[off + i] = qtolower(ref[off + i]);
+            qmemlower(buf + off, len);
+            EXPECT_EQ(0, memcmp(ref, buf, sizeof(buf))) << "lower len " << len << " off " << off;
+
+            for (i = 0; i < len; i++)
+                ref[off + i] = qtoupper(ref[off + i]);
+            qmemupper(buf + off, len);
+            EXPECT_EQ(0, memcmp(ref, buf, sizeof(buf))) << "upper len " << len << " off " << off;
+        }
+}
+
+TEST(qstring, kernels)
+{
+    EXPECT_TRUE(qstr_kernels(QSTR_SCALAR));
+    EXPECT_TRUE(qstr_kernels(QSTR_AUTO));
+    EXPECT_FALSE(qstr_kernels(100));
+}
+
+TEST(qstring, memfind)
+{
+    FOR_EACH_KERNEL(check_find());
+}
+
+TEST(qstring, memicmp)
+{
+    FOR_EACH_KERNEL(check_icmp());
+}
+
+TEST(qstring, memfold)
+{
+    FOR_EACH_KERNEL(check_fold());
+}
+
+TEST(qstring, wide)
+{
+    FOR_EACH_KERNEL(check_wide());
+}
@@ -0,0 +1,113 @@
+/*
+ *  test-reactor.cpp
+ *  Created on: Oct 17, 2026
+ *
+ *  Copyright (c) 2026 by Leo Hoo
+ *  lion@9465.net
+ */
+
+#ifndef _WIN32
+
+#include "gtest/gtest.h"
+#include "exlib/include/service.h"
+#include "exlib/include/reactor.h"
+#include <fcntl.h>
+#include <unistd.h>
+#include <chrono>
+
+using namespace exlib;
+
+static int64_t now_us()
+{
+    return (int64_t)std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+}
+
+class pipe_writer : public OSThread {
+public:
+    pipe_writer(int32_t fd)
+        : m_fd(fd)
+    {
+    }
+
+public:
+    virtual void Run()
+    {
+        OSThread::sleep(5);
+        m_start.post();
+        OSThread::sleep(20);
+
+        char c = 1;
+        ssize_t r = ::write(m_fd, &c, 1);
+        (void)r;
+    }
+
+public:
+    Semaphore m_start;
+
+private:
+    int32_t m_fd;
+};
+
+class pipe_waiter {
+public:
+    int32_t m_fd;
+    volatile bool m_ready;
+    int64_t m_woken;
+};
+
+static void wait_proc(void* p)
+{
+    pipe_waiter* w = (pipe_waiter*)p;
+
+    w->m_ready = Reactor::wait_readable(w->m_fd);
+    w->m_woken = now_us();
+}
+
+// the worker that polled goes off to run a fiber that never yields, the
+// fd it leaves armed is still seen by another worker
+TEST(reactor, ready_while_spinning)
+{
+    int32_t round;
+
+    for (round = 0; round < 10; round++) {
+        int32_t fds[2];
+        pipe_waiter w;
+        Fiber* fb;
+
+        ASSERT_EQ(0, pipe(fds));
+        fcntl(fds[0], F_SETFL, fcntl(fds[0], F_GETFL, 0) | O_NONBLOCK);
+
+        w.m_fd = fds[0];
+        w.m_ready = false;
+        w.m_woken = 0;
+        Service::Create(wait_proc, &w, 64 * 1024, NULL, &fb);
+        ASSERT_TRUE(fb != NULL);
+
+        Fiber::usleep(5000);
+
+        pipe_writer* writer = new pipe_writer(fds[1]);
+        writer->Ref();
+        writer->start();
+        writer->m_start.wait();
+
+        int64_t t = now_us();
+        while (!w.m_ready && now_us() - t < 1000000)
+            ;
+
+        EXPECT_TRUE(w.m_ready);
+        EXPECT_LT(w.m_woken - t, 500000);
+
+        fb->join();
+        fb->Unref();
+
+        writer->join();
+        writer->Unref();
+
+        Reactor::close(fds[0]);
+        ::close(fds[1]);
+    }
+}
+
+#endif
@@ -0,0 +1,239 @@
+/*
+ *  test-timer.cpp
+ *  Created on: Oct 17, 2026
+ *
+ *  Copyright (c) 2026 by Leo Hoo
+ *  lion@9465.net
+ */
+
+#include "gtest/gtest.h"
+#include "exlib/include/service.h"
+#include <chrono>
+
+using namespace exlib;
+
+static int64_t now_us()
+{
+    return (int64_t)std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+}
+
+TEST(timer, usleep_not_early)
+{
+    static const int64_t delays[] = { 1, 50, 99, 100, 101, 250, 1000, 2500, 10000 };
+    int32_t i, k;
+
+    for (i = 0; i < (int32_t)(sizeof(delays) / sizeof(delays[0])); i++)
+        for (k = 0; k < 5; k++) {
+            int64_t t = now_us();
+            Fiber::usleep(delays[i]);
+            EXPECT_GE(now_us() - t, delays[i]);
+        }
+}
+
+TEST(timer, timed_wait_not_early)
+{
+    static const int64_t delays[] = { 1, 100, 150, 1000, 5000 };
+    int32_t i;
+
+    for (i = 0; i < (int32_t)(sizeof(delays) / sizeof(delays[0])); i++) {
+        Event ev;
+        Semaphore sem;
+        Locker l;
+        CondVar cv;
+        int64_t t;
+
+        t = now_us();
+        EXPECT_FALSE(ev.wait(delays[i]));
+        EXPECT_GE(now_us() - t, delays[i]);
+        EXPECT_EQ(0, ev.count());
+
+        t = now_us();
+        EXPECT_FALSE(sem.wait(delays[i]));
+        EXPECT_GE(now_us() - t, delays[i]);
+        EXPECT_EQ(0, sem.count());
+
+        l.lock();
+        t = now_us();
+        EXPECT_FALSE(cv.wait(l, delays[i]));
+        EXPECT_GE(now_us() - t, delays[i]);
+        EXPECT_TRUE(l.owned());
+        l.unlock();
+        EXPECT_EQ(0, cv.count());
+    }
+}
+
+class sleep_job {
+public:
+    int64_t m_us;
+    int64_t m_slept;
+    Fiber* m_fb;
+};
+
+static void sleep_proc(void* p)
+{
+    sleep_job* job = (sleep_job*)p;
+    int64_t t = now_us();
+
+    Fiber::usleep(job->m_us);
+    job->m_slept = now_us() - t;
+}
+
+// the lower wheel spans 25.6ms, the next level 1.6s: these land on the
+// first three levels and have to be cascaded down before they fire
+TEST(timer, cascade)
+{
+    static const int64_t delays[] = {
+        300, 20000, 25600, 26000, 30000, 77000, 160000, 500000, 1700000
+    };
+    const int32_t cnt = (int32_t)(sizeof(delays) / sizeof(delays[0]));
+    sleep_job jobs[cnt];
+    int32_t i;
+
+    for (i = 0; i < cnt; i++) {
+        jobs[i].m_us = delays[cnt - i - 1];
+        jobs[i].m_slept = 0;
+        Service::Create(sleep_proc, &jobs[i], 64 * 1024, NULL, &jobs[i].m_fb);
+        ASSERT_TRUE(jobs[i].m_fb != NULL);
+    }
+
+    for (i = 0; i < cnt; i++) {
+        jobs[i].m_fb->join();
+        jobs[i].m_fb->Unref();
+
+        EXPECT_GE(jobs[i].m_slept, jobs[i].m_us);
+        EXPECT_LT(jobs[i].m_slept, jobs[i].m_us + 200000);
+    }
+}
+
+static void long_sleep_proc(void* p)
+{
+    int64_t* slept = (int64_t*)p;
+    int64_t t = now_us();
+
+    Fiber::usleep(10000000);
+    *slept = now_us() - t;
+}
+
+TEST(timer, cancel_sleep)
+{
+    int64_t slept = 0;
+    Fiber* fb;
+
+    Service::Create(long_sleep_proc, &slept, 64 * 1024, NULL, &fb);
+    ASSERT_TRUE(fb != NULL);
+
+    // the timer is only armed once the fiber has switched out
+    while (slept == 0) {
+        Fiber::usleep(1000);
+        Fiber::cancel_sleep(fb);
+    }
+
+    fb->join();
+    EXPECT_LT(slept, 1000000);
+
+    // nothing to cancel once the fiber is awake
+    Fiber::cancel_sleep(fb);
+    fb->Unref();
+}
+
+#define RACE_ROUNDS 2000
+
+class race_state {
+public:
+    race_state()
+        : m_us(0)
+        , m_woken(0)
+        , m_signaled(0)
+        , m_timedout(0)
+    {
+    }
+
+public:
+    Event m_ev;
+    Semaphore m_sem;
+    Semaphore m_done;
+    int64_t m_us;
+    int32_t m_woken;
+    int32_t m_signaled;
+    int32_t m_timedout;
+};
+
+static void event_waiter(void* p)
+{
+    race_state* s = (race_state*)p;
+
+    if (s->m_ev.wait(s->m_us))
+        s->m_signaled++;
+    else
+        s->m_timedout++;
+    s->m_woken++;
+    s->m_done.post();
+}
+
+static void sem_waiter(void* p)
+{
+    race_state* s = (race_state*)p;
+
+    if (s->m_sem.wait(s->m_us))
+        s->m_signaled++;
+    else
+        s->m_timedout++;
+    s->m_woken++;
+    s->m_done.post();
+}
+
+// set() lands on either side of the deadline, the waiter is resumed once
+TEST(timer, event_timeout_race)
+{
+    race_state s;
+    int32_t i;
+
+    for (i = 0; i < RACE_ROUNDS; i++) {
+        s.m_ev.reset();
+        s.m_us = 100 + (i % 4) * 50;
+
+        Service::Create(event_waiter, &s, 64 * 1024);
+        Fiber::usleep(s.m_us - 50 + (i % 7) * 20);
+        s.m_ev.set();
+
+        s.m_done.wait();
+        EXPECT_EQ(0, s.m_ev.count());
+    }
+
+    Fiber::sleep(10);
+    EXPECT_EQ(RACE_ROUNDS, s.m_woken);
+    EXPECT_EQ(RACE_ROUNDS, s.m_signaled + s.m_timedout);
+    EXPECT_FALSE(s.m_done.trywait());
+}
+
+// a post() that loses the race to the timeout must stay in the semaphore
+TEST(timer, semaphore_timeout_race)
+{
+    race_state s;
+    int32_t i;
+
+    for (i = 0; i < RACE_ROUNDS; i++) {
+        int32_t signaled = s.m_signaled;
+
+        s.m_us = 100 + (i % 4) * 50;
+
+        Service::Create(sem_waiter, &s, 64 * 1024);
+        Fiber::usleep(s.m_us - 50 + (i % 7) * 20);
+        s.m_sem.post();
+
+        s.m_done.wait();
+        EXPECT_EQ(0, s.m_sem.count());
+
+        if (s.m_signaled == signaled) {
+            EXPECT_TRUE(s.m_sem.trywait());
+        }
+        EXPECT_FALSE(s.m_sem.trywait());
+    }
+
+    Fiber::sleep(10);
+    EXPECT_EQ(RACE_ROUNDS, s.m_woken);
+    EXPECT_EQ(RACE_ROUNDS, s.m_signaled + s.m_timedout);
+    EXPECT_FALSE(s.m_done.trywait());
+}
@@ -0,0 +1,65 @@
+/*
+ *  testmain.cpp
+ *  Created on: Oct 17, 2026
+ *
+ *  Copyright (c) 2026 by Leo Hoo
+ *  lion@9465.net
+ */
+
+#include "gtest/gtest.h"
+#include "exlib/include/service.h"
+#include <unistd.h>
+#include <stdio.h>
+#include <chrono>
+
+#define SWITCH_ROUNDS 5000000
+
+static void* s_main;
+static void* s_peer;
+static volatile intptr_t s_count;
+
+static void pong(void* p)
+{
+    while (true) {
+        s_count++;
+        exlib::switch_fiber(s_peer, s_main);
+    }
+}
+
+// two contexts bounce control back and forth, each round trip is two switches
+TEST(fiber, switch_pingpong)
+{
+    s_main = exlib::convert_Fiber(NULL);
+    s_peer = exlib::create_fiber(64 * 1024, pong, NULL);
+    ASSERT_TRUE(s_peer != NULL);
+
+    for (int32_t k = 0; k < 3; k++) {
+        auto t0 = std::chrono::steady_clock::now();
+
+        s_count = 0;
+        for (int32_t i = 0; i < SWITCH_ROUNDS; i++)
+            exlib::switch_fiber(s_main, s_peer);
+
+        double ns = std::chrono::duration<double, std::nano>(
+                        std::chrono::steady_clock::now() - t0)
+                        .count();
+
+        EXPECT_EQ(SWITCH_ROUNDS, s_count);
+        printf("switch_fiber: %.2fns per switch\n", ns / SWITCH_ROUNDS / 2);
+    }
+}
+
+void fiber_proc(void* p)
+{
+    _exit(RUN_ALL_TESTS());
+}
+
+int main(int argc, char* argv[])
+{
+    testing::InitGoogleTest(&argc, argv);
+
+    exlib::Service::init(3);
+    exlib::Service::Create(fiber_proc, 0, 128 * 1024);
+    exlib::Service::dispatch();
+    return 0;
+}
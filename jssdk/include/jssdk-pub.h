@@ -7,6 +7,7 @@
  */
 
 #include <assert.h>
+#include <vector>
 
 #ifndef _jssdk_pub_h__
 #define _jssdk_pub_h__
@@ -28,39 +29,82 @@ public:
 	virtual exlib::string ValueToString(const Value& v) = 0;
 	virtual bool ValueIsString(const Value& v) = 0;
 
-	virtual bool ObjectHas(const Object& o, exlib::string key) = 0;
-	virtual Value ObjectGet(const Object& o, exlib::string key) = 0;
-	virtual void ObjectSet(const Object& o, exlib::string key, const Value& v) = 0;
-	virtual void ObjectRemove(const Object& o, exlib::string key) = 0;
+	virtual bool ObjectHas(const Object& o, const exlib::string& key) = 0;
+	virtual Value ObjectGet(const Object& o, const exlib::string& key) = 0;
+	virtual void ObjectSet(const Object& o, const exlib::string& key, const Value& v) = 0;
+	virtual void ObjectRemove(const Object& o, const exlib::string& key) = 0;
 	virtual Array ObjectKeys(const Object& o) = 0;
-	virtual bool ObjectHasPrivate(const Object& o, exlib::string key) = 0;
-	virtual Value ObjectGetPrivate(const Object& o, exlib::string key) = 0;
-	virtual void ObjectSetPrivate(const Object& o, exlib::string key, const Value& v) = 0;
-	virtual void ObjectRemovePrivate(const Object& o, exlib::string key) = 0;
+	virtual bool ObjectHasPrivate(const Object& o, const exlib::string& key) = 0;
+	virtual Value ObjectGetPrivate(const Object& o, const exlib::string& key) = 0;
+	virtual void ObjectSetPrivate(const Object& o, const exlib::string& key, const Value& v) = 0;
+	virtual void ObjectRemovePrivate(const Object& o, const exlib::string& key) = 0;
 	virtual bool ValueIsObject(const Value& v) = 0;
 
+	virtual void PropertyKey_init(PropertyKey& key, const exlib::string& name) = 0;
+	virtual void PropertyKey_release(PropertyKey& key) = 0;
+	virtual bool ObjectHas(const Object& o, const PropertyKey& key) = 0;
+	virtual Value ObjectGet(const Object& o, const PropertyKey& key) = 0;
+	virtual void ObjectSet(const Object& o, const PropertyKey& key, const Value& v) = 0;
+	virtual void ObjectRemove(const Object& o, const PropertyKey& key) = 0;
+
 	virtual int32_t ArrayGetLength(const Array& a) = 0;
 	virtual Value ArrayGet(const Array& a, int32_t idx) = 0;
 	virtual void ArraySet(const Array& a, int32_t idx, const Value& v) = 0;
 	virtual void ArrayRemove(const Array& a, int32_t idx) = 0;
 	virtual bool ValueIsArray(const Value& v) = 0;
 
+	// copy min(length, count) elements, converting each to a number
+	virtual int32_t ArrayGetNumbers(const Array& a, double* buf, int32_t count) = 0;
+	virtual int32_t ArrayGetNumbers(const Array& a, int32_t* buf, int32_t count) = 0;
+	virtual void ArraySetNumbers(const Array& a, const double* buf, int32_t count) = 0;
+	virtual void ArraySetNumbers(const Array& a, const int32_t* buf, int32_t count) = 0;
+
+	// backing store of an ArrayBuffer or a view on one, NULL for anything else
+	virtual void* ValueGetBuffer(const Value& v, size_t& length) = 0;
+	virtual bool ValueIsArrayBuffer(const Value& v) = 0;
+	virtual bool ValueIsTypedArray(const Value& v) = 0;
+
 	virtual Value FunctionCall(const Function& f, Object obj, Value* args, int32_t argn) = 0;
 	virtual bool ValueIsFunction(const Value& v) = 0;
 
 public:
 	virtual void gc() = 0;
 
+	// ArrayBuffer bytes in use, and bytes the allocator holds beyond them
+	virtual void getBufferStats(size_t& used, size_t& cached) = 0;
+
+	// ArrayBuffer memory comes from a pooled allocator, large buffers are
+	// mapped pages. memory handed to v8 with kInternalized must come from
+	// malloc(), and contents taken over with Externalize() are released
+	// here, never with free().
+	virtual void FreeBuffer(void* data, size_t length) = 0;
+
 	virtual Object GetGlobal() = 0;
 
-	virtual Value execute(exlib::string code, exlib::string soname) = 0;
+	// runs in the runtime's own context, or in a fresh one when isolated.
+	// compiled scripts are kept per soname while the code stays the same.
+	virtual Value execute(const exlib::string& code, const exlib::string& soname,
+	                      bool isolated = false) = 0;
+
+	virtual bool saveCodeCache(const exlib::string& fname) = 0;
+	virtual bool loadCodeCache(const exlib::string& fname) = 0;
+	virtual void clearCodeCache() = 0;
+
+	// scripts compiled from loaded cache data, and those v8 refused. within
+	// one runtime v8 may answer from its own compilation cache instead.
+	virtual void getCodeCacheStats(int32_t& consumed, int32_t& rejected) = 0;
 
 	virtual Value NewUndefined() = 0;
 	virtual Value NewBoolean(bool b) = 0;
 	virtual Value NewNumber(double d) = 0;
-	virtual Value NewString(exlib::string s) = 0;
+	virtual Value NewString(const exlib::string& s) = 0;
 	virtual Object NewObject() = 0;
+	virtual Object NewObject(const exlib::string* keys, const Value* values, int32_t count) = 0;
+	virtual Object NewObject(const PropertyKey* const* keys, const Value* values, int32_t count) = 0;
 	virtual Array NewArray(int32_t sz) = 0;
+	virtual Value NewArrayBuffer(size_t sz) = 0;
+	virtual Value NewFloat64Array(int32_t length) = 0;
+	virtual Value NewInt32Array(int32_t length) = 0;
 	virtual Function NewFunction(FunctionCallback callback) = 0;
 };
 
@@ -142,6 +186,21 @@ public:
 		return m_rt->ValueIsFunction(*this);
 	}
 
+	bool isArrayBuffer() const
+	{
+		return m_rt->ValueIsArrayBuffer(*this);
+	}
+
+	bool isTypedArray() const
+	{
+		return m_rt->ValueIsTypedArray(*this);
+	}
+
+	void* getBuffer(size_t& length) const
+	{
+		return m_rt->ValueGetBuffer(*this, length);
+	}
+
 public:
 	Runtime *m_rt;
 	js_value m_v;
@@ -164,44 +223,64 @@ public:
 	}
 
 public:
-	bool has(exlib::string key)
+	bool has(const exlib::string& key)
 	{
 		return m_rt->ObjectHas(*this, key);
 	}
 
-	Value get(exlib::string key)
+	Value get(const exlib::string& key)
 	{
 		return m_rt->ObjectGet(*this, key);
 	}
 
-	void set(exlib::string key, const Value& v)
+	void set(const exlib::string& key, const Value& v)
 	{
 		m_rt->ObjectSet(*this, key, v);
 	}
 
-	void remove(exlib::string key)
+	void remove(const exlib::string& key)
+	{
+		m_rt->ObjectRemove(*this, key);
+	}
+
+	bool has(const PropertyKey& key)
+	{
+		return m_rt->ObjectHas(*this, key);
+	}
+
+	Value get(const PropertyKey& key)
+	{
+		return m_rt->ObjectGet(*this, key);
+	}
+
+	void set(const PropertyKey& key, const Value& v)
+	{
+		m_rt->ObjectSet(*this, key, v);
+	}
+
+	void remove(const PropertyKey& key)
 	{
 		m_rt->ObjectRemove(*this, key);
 	}
 
 	Array keys();
 
-	bool hasPrivate(exlib::string key)
+	bool hasPrivate(const exlib::string& key)
 	{
 		return m_rt->ObjectHasPrivate(*this, key);
 	}
 
-	Value getPrivate(exlib::string key)
+	Value getPrivate(const exlib::string& key)
 	{
 		return m_rt->ObjectGetPrivate(*this, key);
 	}
 
-	void setPrivate(exlib::string key, const Value& v)
+	void setPrivate(const exlib::string& key, const Value& v)
 	{
 		m_rt->ObjectSetPrivate(*this, key, v);
 	}
 
-	void removePrivate(exlib::string key)
+	void removePrivate(const exlib::string& key)
 	{
 		m_rt->ObjectRemovePrivate(*this, key);
 	}
@@ -243,6 +322,26 @@ public:
 	{
 		m_rt->ArrayRemove(*this, idx);
 	}
+
+	int32_t getNumbers(double* buf, int32_t count)
+	{
+		return m_rt->ArrayGetNumbers(*this, buf, count);
+	}
+
+	int32_t getNumbers(int32_t* buf, int32_t count)
+	{
+		return m_rt->ArrayGetNumbers(*this, buf, count);
+	}
+
+	void setNumbers(const double* buf, int32_t count)
+	{
+		m_rt->ArraySetNumbers(*this, buf, count);
+	}
+
+	void setNumbers(const int32_t* buf, int32_t count)
+	{
+		m_rt->ArraySetNumbers(*this, buf, count);
+	}
 };
 
 class Function: public Object
@@ -283,11 +382,104 @@ public:
 	}
 };
 
+// runtimes kept warm for quick hand out. acquire() takes an idle one or
+// makes a new one, release() resets it and keeps up to size of them.
+class RuntimePool
+{
+public:
+	RuntimePool(Api* api, const exlib::string& snapshot, int32_t size) :
+		m_api(api), m_snapshot(snapshot), m_size(size)
+	{
+		int32_t i;
+
+		m_idle.reserve(size);
+		for (i = 0; i < size; i ++)
+			m_idle.push_back(create());
+	}
+
+	~RuntimePool()
+	{
+		size_t i;
+
+		for (i = 0; i < m_idle.size(); i ++)
+			m_idle[i]->destroy();
+	}
+
+public:
+	Runtime* acquire()
+	{
+		Runtime* rt = NULL;
+
+		m_lock.lock();
+		if (!m_idle.empty())
+		{
+			rt = m_idle.back();
+			m_idle.pop_back();
+		}
+		m_lock.unlock();
+
+		return rt ? rt : create();
+	}
+
+	void release(Runtime* rt)
+	{
+		if (idle() < m_size)
+		{
+			rt->reset();
+
+			m_lock.lock();
+			if ((int32_t)m_idle.size() < m_size)
+			{
+				m_idle.push_back(rt);
+				rt = NULL;
+			}
+			m_lock.unlock();
+		}
+
+		if (rt)
+			rt->destroy();
+	}
+
+	int32_t idle()
+	{
+		int32_t n;
+
+		m_lock.lock();
+		n = (int32_t)m_idle.size();
+		m_lock.unlock();
+
+		return n;
+	}
+
+private:
+	Runtime* create()
+	{
+		return m_snapshot.empty() ? m_api->createRuntime() : m_api->createRuntime(m_snapshot);
+	}
+
+private:
+	Api* m_api;
+	exlib::string m_snapshot;
+	int32_t m_size;
+	exlib::spinlock m_lock;
+	std::vector<Runtime*> m_idle;
+};
+
 inline Array Object::keys()
 {
 	return m_rt->ObjectKeys(*this);
 }
 
+inline PropertyKey::PropertyKey(Runtime* rt, const exlib::string& name) : m_rt(rt)
+{
+	rt->PropertyKey_init(*this, name);
+}
+
+inline PropertyKey::~PropertyKey()
+{
+	m_rt->PropertyKey_release(*this);
+}
+
 inline Runtime_core::Locker::Locker(Runtime* rt) : m_rt(rt)
 {
 	rt->Locker_enter(*this);
@@ -91,6 +91,25 @@ private:
 	friend class v8_Runtime;
 };
 
+// an internalized key made once and reused on every access. it belongs
+// to the runtime that made it and must be released before it is destroyed
+class PropertyKey
+{
+public:
+	PropertyKey(Runtime* rt, const exlib::string& name);
+	~PropertyKey();
+
+private:
+	PropertyKey(const PropertyKey&);
+	PropertyKey& operator=(const PropertyKey&);
+
+private:
+	Runtime* m_rt;
+	v8::Persistent<v8::String> m_key;
+
+	friend class v8_Runtime;
+};
+
 class FunctionCallbackInfo;
 typedef void (*FunctionCallback)(const FunctionCallbackInfo& info);
 
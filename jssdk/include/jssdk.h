@@ -22,6 +22,7 @@ class Array;
 class Function;
 class HandleScope;
 class EscapableHandleScope;
+class PropertyKey;
 class Runtime;
 
 class Runtime_core
@@ -36,6 +37,8 @@ public:
 
 public:
 	virtual void destroy() = 0;
+	// drop the global context and start over in a fresh one
+	virtual void reset() = 0;
 
 	virtual void Locker_enter(Locker& locker) = 0;
 	virtual void Locker_leave(Locker& locker) = 0;
@@ -67,6 +70,13 @@ public:
 	virtual int32_t getVersion() = 0;
 	virtual void init() = 0;
 	virtual Runtime* createRuntime() = 0;
+
+	// the runtime keeps its own copy of the snapshot
+	virtual Runtime* createRuntime(const exlib::string& snapshot) = 0;
+	// runs the same steps as mksnapshot: embed is run in the context that
+	// gets saved, warmup is run in a scratch one so its code is compiled
+	virtual bool createSnapshot(const exlib::string& embed, const exlib::string& warmup,
+	                            exlib::string& snapshot) = 0;
 };
 
 extern Api* v8_api;
@@ -12,7 +12,7 @@
 namespace js
 {
 
-const int32_t Api::version = 1;
+const int32_t Api::version = 2;
 Api* v8_api;
 Api* spider_api;
 
@@ -8,9 +8,18 @@
 
 #include "jssdk-v8.h"
 #include "libplatform/libplatform.h"
+#include "exlib/include/service.h"
+#include <math.h>
+#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <vector>
+#include <map>
+#include <set>
+
+#ifndef _WIN32
+#include <sys/mman.h>
+#endif
 
 namespace js
 {
@@ -18,31 +27,309 @@ namespace js
 class v8_Runtime : public Runtime
 {
 private:
-	class ShellArrayBufferAllocator : public v8::ArrayBuffer::Allocator
+	// small buffers are rounded up to a power of two and kept on a free list
+	// per size, large ones are mapped fresh and come zeroed. v8 already
+	// counts byte lengths as external memory, what the pools hold on top of
+	// that is reported from report(). Free may run on gc threads.
+	//
+	// Free also sees memory embedders handed to v8 with kInternalized, so
+	// blocks handed out here are remembered, large ones in m_mapped and
+	// small ones in m_owned. Anything else goes to free() and is left out
+	// of the stats, it was never counted in them.
+	class ArrayBufferAllocator : public v8::ArrayBuffer::Allocator
 	{
+	public:
+		enum
+		{
+			MIN_SHIFT = 6,
+			MAX_SHIFT = 16,
+			CLASS_COUNT = MAX_SHIFT - MIN_SHIFT + 1,
+			// bytes kept for reuse in each size class
+			CLASS_CACHE = 1024 * 1024
+		};
+
+		ArrayBufferAllocator() : m_used(0), m_cached(0), m_slack(0), m_reported(0)
+		{
+			memset(m_free, 0, sizeof(m_free));
+			memset(m_cachedSize, 0, sizeof(m_cachedSize));
+		}
+
+		~ArrayBufferAllocator()
+		{
+			trim();
+		}
+
 	public:
 		virtual void* Allocate(size_t length)
 		{
-			void* data = AllocateUninitialized(length);
-			return data == NULL ? data : memset(data, 0, length);
+			return alloc(length, true);
 		}
 
 		virtual void* AllocateUninitialized(size_t length)
 		{
-			return malloc(length);
+			return alloc(length, false);
+		}
+
+		virtual void Free(void* data, size_t length)
+		{
+			int32_t cls = size_class(length);
+
+			if (data == NULL)
+				return;
+
+			if (cls == CLASS_COUNT)
+			{
+				bool mapped;
+
+				m_lock.lock();
+				mapped = m_mapped.erase(data) > 0;
+				if (mapped)
+					m_used -= length;
+				m_lock.unlock();
+
+				if (mapped)
+					unmap(data, length);
+				else
+					free(data);
+				return;
+			}
+
+			size_t sz = class_size(cls);
+
+			m_lock.lock();
+			if (m_owned.count(data))
+			{
+				m_used -= length;
+				m_slack -= sz - length;
+
+				if (m_cachedSize[cls] + sz <= CLASS_CACHE)
+				{
+					free_block* blk = (free_block*)data;
+
+					blk->m_next = m_free[cls];
+					m_free[cls] = blk;
+					m_cachedSize[cls] += sz;
+					m_cached += sz;
+					data = NULL;
+				}
+				else
+					m_owned.erase(data);
+			}
+			m_lock.unlock();
+
+			if (data)
+				free(data);
+		}
+
+	public:
+		void trim()
+		{
+			free_block* lists[CLASS_COUNT];
+			int32_t i;
+
+			m_lock.lock();
+			memcpy(lists, m_free, sizeof(lists));
+			memset(m_free, 0, sizeof(m_free));
+			memset(m_cachedSize, 0, sizeof(m_cachedSize));
+			m_cached = 0;
+
+			for (i = 0; i < CLASS_COUNT; i ++)
+				for (free_block* blk = lists[i]; blk; blk = blk->m_next)
+					m_owned.erase(blk);
+			m_lock.unlock();
+
+			for (i = 0; i < CLASS_COUNT; i ++)
+				while (lists[i])
+				{
+					free_block* blk = lists[i];
+
+					lists[i] = blk->m_next;
+					free(blk);
+				}
+		}
+
+		void stats(size_t& used, size_t& cached)
+		{
+			m_lock.lock();
+			used = m_used;
+			cached = m_cached + m_slack;
+			m_lock.unlock();
+		}
+
+		// must be called by the thread that holds the isolate
+		void report(v8::Isolate* isolate)
+		{
+			m_lock.lock();
+			int64_t held = (int64_t)(m_cached + m_slack);
+			int64_t delta = held - m_reported;
+			m_reported = held;
+			m_lock.unlock();
+
+			if (delta)
+				isolate->AdjustAmountOfExternalAllocatedMemory(delta);
+		}
+
+	private:
+		class free_block
+		{
+		public:
+			free_block* m_next;
+		};
+
+		static int32_t size_class(size_t length)
+		{
+			int32_t cls = 0;
+
+			if (length > ((size_t)1 << MAX_SHIFT))
+				return CLASS_COUNT;
+
+			while (((size_t)1 << (cls + MIN_SHIFT)) < length)
+				cls ++;
+
+			return cls;
+		}
+
+		static size_t class_size(int32_t cls)
+		{
+			return (size_t)1 << (cls + MIN_SHIFT);
 		}
 
-		virtual void Free(void* data, size_t)
+		void* alloc(size_t length, bool zero)
 		{
+			int32_t cls = size_class(length);
+			void* data;
+
+			if (cls == CLASS_COUNT)
+			{
+				data = map(length);
+				if (data)
+				{
+					m_lock.lock();
+					m_used += length;
+					m_mapped.insert(data);
+					m_lock.unlock();
+				}
+
+				return data;
+			}
+
+			size_t sz = class_size(cls);
+			free_block* blk;
+
+			m_lock.lock();
+			blk = m_free[cls];
+			if (blk)
+			{
+				m_free[cls] = blk->m_next;
+				m_cachedSize[cls] -= sz;
+				m_cached -= sz;
+				m_used += length;
+				m_slack += sz - length;
+			}
+			m_lock.unlock();
+
+			if (blk)
+			{
+				// only what the caller can see needs zeroing
+				if (zero)
+					memset(blk, 0, length);
+				return blk;
+			}
+
+			data = zero ? calloc(1, sz) : malloc(sz);
+			if (data)
+			{
+				m_lock.lock();
+				m_used += length;
+				m_slack += sz - length;
+				m_owned.insert(data);
+				m_lock.unlock();
+			}
+
+			return data;
+		}
+
+		static void* map(size_t length)
+		{
+#ifdef _WIN32
+			return calloc(1, length);
+#else
+			void* data = mmap(NULL, length, PROT_READ | PROT_WRITE,
+			                  MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+			return data == MAP_FAILED ? NULL : data;
+#endif
+		}
+
+		static void unmap(void* data, size_t length)
+		{
+#ifdef _WIN32
 			free(data);
+#else
+			munmap(data, length);
+#endif
 		}
+
+	private:
+		exlib::spinlock m_lock;
+		free_block* m_free[CLASS_COUNT];
+		size_t m_cachedSize[CLASS_COUNT];
+		std::set<void*> m_mapped;
+		std::set<void*> m_owned;
+		size_t m_used;
+		size_t m_cached;
+		size_t m_slack;
+		int64_t m_reported;
+	};
+
+	class ScriptEntry
+	{
+	public:
+		ScriptEntry() : m_hash(0)
+		{}
+
+	public:
+		exlib::string m_code;
+		uint64_t m_hash;
+		v8::Persistent<v8::UnboundScript> m_script;
+		// serialized code, produced when saving or read back from a file
+		exlib::string m_cache;
+	};
+
+	enum
+	{
+		MAX_SCRIPTS = 1024
 	};
 
+	static const char* const CACHE_MAGIC;
+
+	static uint64_t hash_code(const exlib::string& code)
+	{
+		const unsigned char* p = (const unsigned char*)code.c_str();
+		size_t sz = code.length();
+		uint64_t h = 14695981039346656037ull;
+
+		while (sz--)
+			h = (h ^ *p++) * 1099511628211ull;
+
+		return h;
+	}
+
 public:
-	v8_Runtime(class Api* api)
+	v8_Runtime(class Api* api, const exlib::string& snapshot = exlib::string())
+		: m_cacheConsumed(0), m_cacheRejected(0)
 	{
 		m_api = api;
 		create_params.array_buffer_allocator = &array_buffer_allocator;
+
+		// v8 reads the blob again whenever it makes a context
+		if (!snapshot.empty())
+		{
+			m_snapshot = snapshot;
+			m_blob.data = m_snapshot.c_str();
+			m_blob.raw_size = (int32_t)m_snapshot.length();
+			create_params.snapshot_blob = &m_blob;
+		}
+
 		m_isolate = v8::Isolate::New(create_params);
 
 		m_isolate->SetData(0, this);
@@ -57,10 +344,25 @@ public:
 public:
 	void destroy()
 	{
+		{
+			v8::Locker locker(m_isolate);
+			clearCodeCache();
+		}
+
 		m_isolate->Dispose();
 		delete this;
 	}
 
+	void reset()
+	{
+		v8::Locker locker(m_isolate);
+		v8::HandleScope handle_scope(m_isolate);
+		v8::Isolate::Scope isolate_scope(m_isolate);
+
+		m_context.Reset(m_isolate, v8::Context::New(m_isolate));
+		m_isolate->ContextDisposedNotification();
+	}
+
 	void Locker_enter(Locker& locker)
 	{
 		new (locker.m_locker) v8::Locker(m_isolate);
@@ -108,6 +410,7 @@ public:
 
 	void Scope_leave(Scope& scope)
 	{
+		array_buffer_allocator.report(m_isolate);
 		v8::Local<v8::Context>::New(m_isolate, m_context)->Exit();
 		m_isolate->Exit();
 		((_HandleScope*)scope.m_handle_scope)->~_HandleScope();
@@ -160,6 +463,19 @@ public:
 	void gc()
 	{
 		m_isolate->LowMemoryNotification();
+		array_buffer_allocator.trim();
+		exlib::Service::trim();
+		array_buffer_allocator.report(m_isolate);
+	}
+
+	void getBufferStats(size_t& used, size_t& cached)
+	{
+		array_buffer_allocator.stats(used, cached);
+	}
+
+	void FreeBuffer(void* data, size_t length)
+	{
+		array_buffer_allocator.Free(data, length);
 	}
 
 	Object GetGlobal()
@@ -167,18 +483,102 @@ public:
 		return Object(this, v8::Local<v8::Context>::New(m_isolate, m_context)->Global());
 	}
 
-	Value execute(exlib::string code, exlib::string soname)
+	v8::MaybeLocal<v8::UnboundScript> compile(const exlib::string& code,
+	        const exlib::string& soname, exlib::string* cache,
+	        v8::ScriptCompiler::CompileOptions options,
+	        exlib::string* produced = NULL)
 	{
-		v8::Local<v8::Context> context = v8::Context::New(m_isolate);
 		v8::Local<v8::String> str_code = v8::String::NewFromUtf8(m_isolate,
 		                                 code.c_str(), v8::String::kNormalString,
 		                                 (int32_t)code.length());
 		v8::Local<v8::String> str_name = v8::String::NewFromUtf8(m_isolate,
 		                                 soname.c_str(), v8::String::kNormalString,
 		                                 (int32_t)soname.length());
-		v8::Local<v8::Script> script = v8::Script::Compile(str_code, str_name);
+		v8::ScriptCompiler::CachedData* cached = NULL;
+
+		if (cache)
+			cached = new v8::ScriptCompiler::CachedData((const uint8_t*)cache->c_str(),
+			        (int32_t)cache->length());
+
+		v8::ScriptOrigin origin(str_name);
+		v8::ScriptCompiler::Source source(str_code, origin, cached);
+		v8::MaybeLocal<v8::UnboundScript> script =
+		    v8::ScriptCompiler::CompileUnboundScript(m_isolate, &source, options);
+
+		// v8 has compiled from source instead, stale data is not kept
+		if (cached && cached->rejected)
+		{
+			cache->clear();
+			m_cacheRejected ++;
+		}
+		else if (cached)
+			m_cacheConsumed ++;
+
+		if (produced)
+		{
+			const v8::ScriptCompiler::CachedData* data = source.GetCachedData();
+
+			if (data)
+				produced->assign((const char*)data->data, data->length);
+		}
+
+		return script;
+	}
+
+	v8::MaybeLocal<v8::UnboundScript> get_script(const exlib::string& code,
+	        const exlib::string& soname)
+	{
+		std::map<exlib::string, ScriptEntry*>::iterator it = m_scripts.find(soname);
+		ScriptEntry* entry;
+
+		if (it != m_scripts.end())
+			entry = it->second;
+		else if (m_scripts.size() < MAX_SCRIPTS)
+			m_scripts.insert(std::make_pair(soname, entry = new ScriptEntry()));
+		else
+			return compile(code, soname, NULL, v8::ScriptCompiler::kNoCompileOptions);
+
+		if (!entry->m_script.IsEmpty() && entry->m_code == code)
+			return v8::Local<v8::UnboundScript>::New(m_isolate, entry->m_script);
+
+		uint64_t hash = hash_code(code);
+		bool consume = !entry->m_cache.empty() && entry->m_hash == hash;
+		v8::ScriptCompiler::CompileOptions options = consume ?
+		        v8::ScriptCompiler::kConsumeCodeCache : v8::ScriptCompiler::kNoCompileOptions;
+
+		v8::MaybeLocal<v8::UnboundScript> script = compile(code, soname,
+		        consume ? &entry->m_cache : NULL, options);
+
+		entry->m_script.Reset();
+		entry->m_code.clear();
+		if (entry->m_hash != hash)
+		{
+			entry->m_hash = hash;
+			entry->m_cache.clear();
+		}
+
+		if (!script.IsEmpty())
+		{
+			entry->m_script.Reset(m_isolate, script.ToLocalChecked());
+			entry->m_code = code;
+		}
+
+		return script;
+	}
+
+	Value execute(const exlib::string& code, const exlib::string& soname, bool isolated)
+	{
+		v8::MaybeLocal<v8::UnboundScript> script = get_script(code, soname);
 
-		v8::MaybeLocal<v8::Value> result = script->Run(context);
+		if (script.IsEmpty())
+			return Value();
+
+		v8::Local<v8::Context> context = isolated ? v8::Context::New(m_isolate) :
+		                                 v8::Local<v8::Context>::New(m_isolate, m_context);
+
+		context->Enter();
+		v8::MaybeLocal<v8::Value> result = script.ToLocalChecked()->BindToCurrentContext()->Run(context);
+		context->Exit();
 
 		if (result.IsEmpty())
 			return Value();
@@ -186,6 +586,129 @@ public:
 		return Value(this, result.ToLocalChecked());
 	}
 
+	bool saveCodeCache(const exlib::string& fname)
+	{
+		std::map<exlib::string, ScriptEntry*>::iterator it;
+		FILE* fp = fopen(fname.c_str(), "wb");
+
+		if (fp == NULL)
+			return false;
+
+		bool ok = fwrite(CACHE_MAGIC, 4, 1, fp) == 1;
+
+		for (it = m_scripts.begin(); ok && it != m_scripts.end(); ++it)
+		{
+			ScriptEntry* entry = it->second;
+
+			if (entry->m_cache.empty() && !entry->m_code.empty())
+			{
+				v8::HandleScope handle_scope(m_isolate);
+
+				// v8 6.2 can only serialize a script while compiling it
+				compile(entry->m_code, it->first, NULL,
+				        v8::ScriptCompiler::kProduceCodeCache, &entry->m_cache);
+			}
+
+			if (entry->m_cache.empty())
+				continue;
+
+			uint32_t name_len = (uint32_t)it->first.length();
+			uint32_t data_len = (uint32_t)entry->m_cache.length();
+
+			ok = fwrite(&name_len, sizeof(name_len), 1, fp) == 1 &&
+			     fwrite(it->first.c_str(), 1, name_len, fp) == name_len &&
+			     fwrite(&entry->m_hash, sizeof(entry->m_hash), 1, fp) == 1 &&
+			     fwrite(&data_len, sizeof(data_len), 1, fp) == 1 &&
+			     fwrite(entry->m_cache.c_str(), 1, data_len, fp) == data_len;
+		}
+
+		return fclose(fp) == 0 && ok;
+	}
+
+	bool loadCodeCache(const exlib::string& fname)
+	{
+		FILE* fp = fopen(fname.c_str(), "rb");
+		char magic[4];
+		long size = -1;
+
+		if (fp == NULL)
+			return false;
+
+		// lengths in a corrupt or truncated file must not size a buffer
+		// past what is left of it, resize() aborts instead of failing
+		if (fseek(fp, 0, SEEK_END) == 0)
+			size = ftell(fp);
+
+		bool ok = size >= 4 && fseek(fp, 0, SEEK_SET) == 0 &&
+		          fread(magic, 4, 1, fp) == 1 && !memcmp(magic, CACHE_MAGIC, 4);
+
+		while (ok)
+		{
+			uint32_t name_len, data_len;
+			uint64_t hash;
+			exlib::string name, data;
+
+			if (fread(&name_len, sizeof(name_len), 1, fp) != 1)
+				break;
+
+			ok = name_len <= (uint64_t)(size - ftell(fp));
+			if (!ok)
+				break;
+
+			name.resize(name_len);
+			ok = fread(&name[0], 1, name_len, fp) == name_len &&
+			     fread(&hash, sizeof(hash), 1, fp) == 1 &&
+			     fread(&data_len, sizeof(data_len), 1, fp) == 1 &&
+			     data_len <= (uint64_t)(size - ftell(fp));
+			if (!ok)
+				break;
+
+			data.resize(data_len);
+			ok = fread(&data[0], 1, data_len, fp) == data_len;
+			if (!ok)
+				break;
+
+			std::map<exlib::string, ScriptEntry*>::iterator it = m_scripts.find(name);
+			ScriptEntry* entry;
+
+			if (it != m_scripts.end())
+				entry = it->second;
+			else if (m_scripts.size() < MAX_SCRIPTS)
+				m_scripts.insert(std::make_pair(name, entry = new ScriptEntry()));
+			else
+				continue;
+
+			// a script compiled here already wins over the file
+			if (entry->m_script.IsEmpty())
+			{
+				entry->m_hash = hash;
+				entry->m_cache = data;
+			}
+		}
+
+		fclose(fp);
+		return ok;
+	}
+
+	void getCodeCacheStats(int32_t& consumed, int32_t& rejected)
+	{
+		consumed = m_cacheConsumed;
+		rejected = m_cacheRejected;
+	}
+
+	void clearCodeCache()
+	{
+		std::map<exlib::string, ScriptEntry*>::iterator it;
+
+		for (it = m_scripts.begin(); it != m_scripts.end(); ++it)
+		{
+			it->second->m_script.Reset();
+			delete it->second;
+		}
+
+		m_scripts.clear();
+	}
+
 	Value NewUndefined()
 	{
 		return Value(this, v8::Undefined(m_isolate));
@@ -201,7 +724,7 @@ public:
 		return Value(this, v8::Number::New(m_isolate, d));
 	}
 
-	Value NewString(exlib::string s)
+	Value NewString(const exlib::string& s)
 	{
 		return Value(this, v8::String::NewFromUtf8(m_isolate, s.c_str(),
 		             v8::String::kNormalString, (int32_t)s.length()));
@@ -212,11 +735,58 @@ public:
 		return Object(this, v8::Object::New(m_isolate));
 	}
 
+	Object NewObject(const exlib::string* keys, const Value* values, int32_t count)
+	{
+		v8::Local<v8::Context> context = v8::Local<v8::Context>::New(m_isolate,
+		                                 m_context);
+		v8::Local<v8::Object> o = v8::Object::New(m_isolate);
+		int32_t i;
+
+		for (i = 0; i < count; i ++)
+			o->CreateDataProperty(context, v8::String::NewFromUtf8(m_isolate,
+			                      keys[i].c_str(), v8::String::kNormalString,
+			                      (int32_t)keys[i].length()), values[i].m_v).IsJust();
+
+		return Object(this, o);
+	}
+
+	Object NewObject(const PropertyKey* const* keys, const Value* values, int32_t count)
+	{
+		v8::Local<v8::Context> context = v8::Local<v8::Context>::New(m_isolate,
+		                                 m_context);
+		v8::Local<v8::Object> o = v8::Object::New(m_isolate);
+		int32_t i;
+
+		for (i = 0; i < count; i ++)
+			o->CreateDataProperty(context, get_key(*keys[i]), values[i].m_v).IsJust();
+
+		return Object(this, o);
+	}
+
 	Array NewArray(int32_t sz)
 	{
 		return Array(this, v8::Array::New(m_isolate, sz));
 	}
 
+	Value NewArrayBuffer(size_t sz)
+	{
+		return Value(this, v8::ArrayBuffer::New(m_isolate, sz));
+	}
+
+	Value NewFloat64Array(int32_t length)
+	{
+		v8::Local<v8::ArrayBuffer> buf = v8::ArrayBuffer::New(m_isolate,
+		                                 length * sizeof(double));
+		return Value(this, v8::Float64Array::New(buf, 0, length));
+	}
+
+	Value NewInt32Array(int32_t length)
+	{
+		v8::Local<v8::ArrayBuffer> buf = v8::ArrayBuffer::New(m_isolate,
+		                                 length * sizeof(int32_t));
+		return Value(this, v8::Int32Array::New(buf, 0, length));
+	}
+
 	Function NewFunction(FunctionCallback callback)
 	{
 		return Function(this, v8::Function::New(m_isolate, (v8::FunctionCallback)callback));
@@ -266,7 +836,7 @@ public:
 	}
 
 public:
-	bool ObjectHas(const Object& o, exlib::string key)
+	bool ObjectHas(const Object& o, const exlib::string& key)
 	{
 		return v8::Local<v8::Object>::Cast(o.m_v)->Has(
 		           v8::String::NewFromUtf8(m_isolate,
@@ -274,7 +844,7 @@ public:
 		                                   (int32_t)key.length()));
 	}
 
-	Value ObjectGet(const Object& o, exlib::string key)
+	Value ObjectGet(const Object& o, const exlib::string& key)
 	{
 		return Value(this, v8::Local<v8::Object>::Cast(o.m_v)->Get(
 		                 v8::String::NewFromUtf8(m_isolate,
@@ -282,7 +852,7 @@ public:
 		                         (int32_t)key.length())));
 	}
 
-	void ObjectSet(const Object& o, exlib::string key, const Value& v)
+	void ObjectSet(const Object& o, const exlib::string& key, const Value& v)
 	{
 		v8::Local<v8::Object>::Cast(o.m_v)->Set(
 		    v8::String::NewFromUtf8(m_isolate,
@@ -290,7 +860,7 @@ public:
 		                            (int32_t)key.length()), v.m_v);
 	}
 
-	void ObjectRemove(const Object& o, exlib::string key)
+	void ObjectRemove(const Object& o, const exlib::string& key)
 	{
 		v8::Local<v8::Object>::Cast(o.m_v)->Delete(
 		    v8::String::NewFromUtf8(m_isolate,
@@ -303,7 +873,7 @@ public:
 		return Array(this, v8::Local<v8::Object>::Cast(o.m_v)->GetPropertyNames());
 	}
 
-	bool ObjectHasPrivate(const Object& o, exlib::string key)
+	bool ObjectHasPrivate(const Object& o, const exlib::string& key)
 	{
 		v8::Local<v8::Private> pkey = v8::Private::ForApi(m_isolate,
 		                              v8::String::NewFromUtf8(m_isolate,
@@ -314,7 +884,7 @@ public:
 		return v8::Local<v8::Object>::Cast(o.m_v)->HasPrivate(context, pkey).FromJust();
 	}
 
-	Value ObjectGetPrivate(const Object& o, exlib::string key)
+	Value ObjectGetPrivate(const Object& o, const exlib::string& key)
 	{
 		v8::Local<v8::Private> pkey = v8::Private::ForApi(m_isolate,
 		                              v8::String::NewFromUtf8(m_isolate,
@@ -331,7 +901,7 @@ public:
 		return Value(this, result.ToLocalChecked());
 	}
 
-	void ObjectSetPrivate(const Object& o, exlib::string key, const Value& v)
+	void ObjectSetPrivate(const Object& o, const exlib::string& key, const Value& v)
 	{
 		v8::Local<v8::Private> pkey = v8::Private::ForApi(m_isolate,
 		                              v8::String::NewFromUtf8(m_isolate,
@@ -342,7 +912,7 @@ public:
 		v8::Local<v8::Object>::Cast(o.m_v)->SetPrivate(context, pkey, v.m_v);
 	}
 
-	void ObjectRemovePrivate(const Object& o, exlib::string key)
+	void ObjectRemovePrivate(const Object& o, const exlib::string& key)
 	{
 		v8::Local<v8::Private> pkey = v8::Private::ForApi(m_isolate,
 		                              v8::String::NewFromUtf8(m_isolate,
@@ -353,6 +923,46 @@ public:
 		v8::Local<v8::Object>::Cast(o.m_v)->DeletePrivate(context, pkey);
 	}
 
+	void PropertyKey_init(PropertyKey& key, const exlib::string& name)
+	{
+		v8::HandleScope handle_scope(m_isolate);
+
+		key.m_key.Reset(m_isolate, v8::String::NewFromUtf8(m_isolate,
+		                name.c_str(), v8::String::kInternalizedString,
+		                (int32_t)name.length()));
+	}
+
+	void PropertyKey_release(PropertyKey& key)
+	{
+		key.m_key.Reset();
+	}
+
+	v8::Local<v8::String> get_key(const PropertyKey& key)
+	{
+		assert(key.m_rt == this);
+		return v8::Local<v8::String>::New(m_isolate, key.m_key);
+	}
+
+	bool ObjectHas(const Object& o, const PropertyKey& key)
+	{
+		return v8::Local<v8::Object>::Cast(o.m_v)->Has(get_key(key));
+	}
+
+	Value ObjectGet(const Object& o, const PropertyKey& key)
+	{
+		return Value(this, v8::Local<v8::Object>::Cast(o.m_v)->Get(get_key(key)));
+	}
+
+	void ObjectSet(const Object& o, const PropertyKey& key, const Value& v)
+	{
+		v8::Local<v8::Object>::Cast(o.m_v)->Set(get_key(key), v.m_v);
+	}
+
+	void ObjectRemove(const Object& o, const PropertyKey& key)
+	{
+		v8::Local<v8::Object>::Cast(o.m_v)->Delete(get_key(key));
+	}
+
 	bool ValueIsObject(const Value& v)
 	{
 		return !v.m_v.IsEmpty() && v.m_v->IsObject();
@@ -384,6 +994,142 @@ public:
 		return !v.m_v.IsEmpty() && v.m_v->IsArray();
 	}
 
+	enum
+	{
+		// elements read or written per handle scope
+		BULK_BLOCK = 256
+	};
+
+	template<typename T>
+	int32_t get_numbers(const Array& a, T* buf, int32_t count)
+	{
+		v8::Local<v8::Context> context = v8::Local<v8::Context>::New(m_isolate,
+		                                 m_context);
+		v8::Local<v8::Array> arr = v8::Local<v8::Array>::Cast(a.m_v);
+		int32_t len = (int32_t)arr->Length();
+		int32_t i = 0;
+
+		if (count > len)
+			count = len;
+
+		while (i < count)
+		{
+			v8::HandleScope handle_scope(m_isolate);
+			int32_t end = count - i > BULK_BLOCK ? i + BULK_BLOCK : count;
+
+			for (; i < end; i ++)
+			{
+				v8::Local<v8::Value> v;
+
+				if (!arr->Get(context, i).ToLocal(&v))
+					v = v8::Undefined(m_isolate);
+				buf[i] = to_number(context, v, buf);
+			}
+		}
+
+		return count;
+	}
+
+	static double to_number(v8::Local<v8::Context> context, v8::Local<v8::Value> v,
+	                        double* tag)
+	{
+		if (v->IsNumber())
+			return v8::Local<v8::Number>::Cast(v)->Value();
+		return v->NumberValue(context).FromMaybe(NAN);
+	}
+
+	static int32_t to_number(v8::Local<v8::Context> context, v8::Local<v8::Value> v,
+	                         int32_t* tag)
+	{
+		if (v->IsInt32())
+			return v8::Local<v8::Int32>::Cast(v)->Value();
+		return v->Int32Value(context).FromMaybe(0);
+	}
+
+	template<typename T>
+	void set_numbers(const Array& a, const T* buf, int32_t count)
+	{
+		v8::Local<v8::Context> context = v8::Local<v8::Context>::New(m_isolate,
+		                                 m_context);
+		v8::Local<v8::Array> arr = v8::Local<v8::Array>::Cast(a.m_v);
+		int32_t i = 0;
+
+		while (i < count)
+		{
+			v8::HandleScope handle_scope(m_isolate);
+			int32_t end = count - i > BULK_BLOCK ? i + BULK_BLOCK : count;
+
+			for (; i < end; i ++)
+				arr->Set(context, i, new_number(buf[i])).IsJust();
+		}
+	}
+
+	v8::Local<v8::Value> new_number(double d)
+	{
+		return v8::Number::New(m_isolate, d);
+	}
+
+	v8::Local<v8::Value> new_number(int32_t n)
+	{
+		return v8::Integer::New(m_isolate, n);
+	}
+
+	int32_t ArrayGetNumbers(const Array& a, double* buf, int32_t count)
+	{
+		return get_numbers(a, buf, count);
+	}
+
+	int32_t ArrayGetNumbers(const Array& a, int32_t* buf, int32_t count)
+	{
+		return get_numbers(a, buf, count);
+	}
+
+	void ArraySetNumbers(const Array& a, const double* buf, int32_t count)
+	{
+		set_numbers(a, buf, count);
+	}
+
+	void ArraySetNumbers(const Array& a, const int32_t* buf, int32_t count)
+	{
+		set_numbers(a, buf, count);
+	}
+
+	void* ValueGetBuffer(const Value& v, size_t& length)
+	{
+		length = 0;
+		if (v.m_v.IsEmpty())
+			return NULL;
+
+		if (v.m_v->IsArrayBuffer())
+		{
+			v8::ArrayBuffer::Contents c = v8::Local<v8::ArrayBuffer>::Cast(v.m_v)->GetContents();
+
+			length = c.ByteLength();
+			return c.Data();
+		}
+
+		if (v.m_v->IsArrayBufferView())
+		{
+			v8::Local<v8::ArrayBufferView> view = v8::Local<v8::ArrayBufferView>::Cast(v.m_v);
+			v8::ArrayBuffer::Contents c = view->Buffer()->GetContents();
+
+			length = view->ByteLength();
+			return (char*)c.Data() + view->ByteOffset();
+		}
+
+		return NULL;
+	}
+
+	bool ValueIsArrayBuffer(const Value& v)
+	{
+		return !v.m_v.IsEmpty() && v.m_v->IsArrayBuffer();
+	}
+
+	bool ValueIsTypedArray(const Value& v)
+	{
+		return !v.m_v.IsEmpty() && v.m_v->IsTypedArray();
+	}
+
 public:
 	Value FunctionCall(const Function& f, Object obj, Value* args, int32_t argn)
 	{
@@ -419,13 +1165,20 @@ public:
 private:
 	v8::Isolate *m_isolate;
 	v8::Persistent<v8::Context> m_context;
+	std::map<exlib::string, ScriptEntry*> m_scripts;
+	int32_t m_cacheConsumed;
+	int32_t m_cacheRejected;
+	exlib::string m_snapshot;
+	v8::StartupData m_blob;
 
 	v8::Isolate::CreateParams create_params;
-	ShellArrayBufferAllocator array_buffer_allocator;
+	ArrayBufferAllocator array_buffer_allocator;
 
 	friend class Api_v8;
 };
 
+const char* const v8_Runtime::CACHE_MAGIC = "JSCC";
+
 class Api_v8 : public Api
 {
 public:
@@ -458,6 +1211,33 @@ public:
 	{
 		return new v8_Runtime(this);
 	}
+
+	virtual Runtime* createRuntime(const exlib::string& snapshot)
+	{
+		return new v8_Runtime(this, snapshot);
+	}
+
+	virtual bool createSnapshot(const exlib::string& embed, const exlib::string& warmup,
+	                            exlib::string& snapshot)
+	{
+		v8::StartupData blob = v8::V8::CreateSnapshotDataBlob(embed.empty() ? NULL : embed.c_str());
+
+		if (blob.data && !warmup.empty())
+		{
+			v8::StartupData cold = blob;
+
+			blob = v8::V8::WarmUpSnapshotDataBlob(cold, warmup.c_str());
+			delete[] cold.data;
+		}
+
+		if (blob.data == NULL)
+			return false;
+
+		snapshot.assign(blob.data, blob.raw_size);
+		delete[] blob.data;
+
+		return true;
+	}
 };
 
 static Api_v8 s_api;
@@ -57,7 +57,7 @@ inline exlib::wstring utf8to16String(const char *src, int32_t srclen = -1)
     return str;
 }
 
-inline exlib::wstring utf8to16String(exlib::string src)
+inline exlib::wstring utf8to16String(const exlib::string& src)
 {
     return utf8to16String(src.c_str(), (int32_t)src.length());
 }
@@ -82,7 +82,7 @@ inline exlib::string utf16to8String(const exlib::wchar *src, int32_t srclen = -1
     return str;
 }
 
-inline exlib::string utf16to8String(exlib::wstring src)
+inline exlib::string utf16to8String(const exlib::wstring& src)
 {
     return utf16to8String(src.c_str(), (int32_t)src.length());
 }
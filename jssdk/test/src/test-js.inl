@@ -130,6 +130,175 @@ TEST(ENG(api), Value_Object_Private)
     ASSERT_TRUE(v.has("key1"));
 }
 
+TEST(ENG(api), PropertyKey)
+{
+    js::Runtime::Scope scope(rt);
+
+    js::PropertyKey key1(rt, "key1");
+    js::PropertyKey key2(rt, "key2");
+    js::Object v = rt->NewObject();
+
+    ASSERT_FALSE(v.has(key1));
+    v.set(key1, rt->NewNumber(100));
+    ASSERT_TRUE(v.has(key1));
+    ASSERT_TRUE(v.has("key1"));
+    EXPECT_EQ(100, v.get(key1).toNumber());
+
+    v.set("key2", rt->NewString("abc"));
+    EXPECT_EQ("abc", v.get(key2).toString());
+
+    js::Object v1 = rt->NewObject();
+    for (int32_t i = 0; i < 1000; i++)
+        v1.set(key1, rt->NewNumber(v1.has(key1) ? v1.get(key1).toNumber() + 1 : 0));
+    EXPECT_EQ(999, v1.get(key1).toNumber());
+
+    v.remove(key1);
+    ASSERT_FALSE(v.has(key1));
+    ASSERT_TRUE(v.get(key1).isUndefined());
+}
+
+TEST(ENG(api), Array_Numbers)
+{
+    js::Runtime::Scope scope(rt);
+
+    double d[1000];
+    int32_t n[1000];
+    int32_t i;
+
+    for (i = 0; i < 1000; i++)
+        d[i] = i + 0.5;
+
+    js::Array a = rt->NewArray(0);
+    a.setNumbers(d, 1000);
+    EXPECT_EQ(1000, a.length());
+    EXPECT_EQ(999.5, a.get(999).toNumber());
+
+    memset(d, 0, sizeof(d));
+    EXPECT_EQ(1000, a.getNumbers(d, 1000));
+    EXPECT_EQ(0.5, d[0]);
+    EXPECT_EQ(600.5, d[600]);
+
+    EXPECT_EQ(1000, a.getNumbers(n, 2000));
+    EXPECT_EQ(600, n[600]);
+
+    js::Array a1 = rt->execute("[1, '2', null, 4.5]", "test.js");
+    EXPECT_EQ(4, a1.getNumbers(d, 10));
+    EXPECT_EQ(2, d[1]);
+    EXPECT_EQ(0, d[2]);
+    EXPECT_EQ(4, a1.getNumbers(n, 10));
+    EXPECT_EQ(4, n[3]);
+
+    for (i = 0; i < 10; i++)
+        n[i] = -i;
+    a1.setNumbers(n, 10);
+    EXPECT_EQ(10, a1.length());
+    EXPECT_EQ(-9, a1.get(9).toNumber());
+}
+
+TEST(ENG(api), Buffer)
+{
+    js::Runtime::Scope scope(rt);
+
+    size_t len;
+    js::Value v = rt->NewFloat64Array(16);
+    ASSERT_TRUE(v.isTypedArray());
+    ASSERT_FALSE(v.isArrayBuffer());
+
+    double* d = (double*)v.getBuffer(len);
+    ASSERT_NE((void*)NULL, d);
+    EXPECT_EQ(16 * sizeof(double), len);
+    d[3] = 7.25;
+
+    rt->GetGlobal().set("buffer_test", v);
+    EXPECT_EQ(7.25, rt->execute("buffer_test[3]", "test.js").toNumber());
+
+    v = rt->execute("var b = new ArrayBuffer(32); new Int32Array(b, 8, 4)[1] = 99; b", "test.js");
+    ASSERT_TRUE(v.isArrayBuffer());
+    int32_t* n = (int32_t*)v.getBuffer(len);
+    EXPECT_EQ(32u, len);
+    EXPECT_EQ(99, n[3]);
+
+    v = rt->execute("new Int32Array(b, 8, 4)", "test.js");
+    n = (int32_t*)v.getBuffer(len);
+    EXPECT_EQ(16u, len);
+    EXPECT_EQ(99, n[1]);
+
+    EXPECT_EQ((void*)NULL, rt->NewNumber(1).getBuffer(len));
+    EXPECT_EQ(0u, len);
+}
+
+TEST(ENG(api), Buffer_Allocator)
+{
+    js::Runtime::Scope scope(rt);
+
+    size_t used, cached, used1, cached1, len;
+
+    // the second pass waits for the first one's sweeping
+    rt->gc();
+    rt->gc();
+    rt->getBufferStats(used, cached);
+
+    {
+        js::HandleScope handle_scope(rt);
+
+        rt->execute("var alloc_test = new ArrayBuffer(5000);", "test.js");
+        rt->getBufferStats(used1, cached1);
+        EXPECT_EQ(used + 5000, used1);
+        EXPECT_EQ(cached + 8192 - 5000, cached1);
+
+        js::Value v = rt->execute("alloc_test = new ArrayBuffer(1024 * 1024); alloc_test", "test.js");
+        unsigned char* p = (unsigned char*)v.getBuffer(len);
+        EXPECT_EQ(1024u * 1024, len);
+        EXPECT_EQ(0, p[0]);
+        EXPECT_EQ(0, p[len - 1]);
+    }
+
+    // reused blocks must come back zeroed
+    EXPECT_EQ(0, rt->execute("var bad = 0;"
+                             "for (var i = 0; i < 4000; i++) {"
+                             "  var a = new Uint8Array(4000 + i % 96);"
+                             "  if (a[0] || a[a.length - 1]) bad++;"
+                             "  a.fill(7);"
+                             "}"
+                             "bad", "test.js").toNumber());
+
+    rt->execute("alloc_test = a = null;", "test.js");
+    rt->gc();
+    rt->gc();
+    rt->getBufferStats(used1, cached1);
+    EXPECT_EQ(used, used1);
+    EXPECT_EQ(cached, cached1);
+
+    // memory that did not come from the allocator goes back to free()
+    rt->FreeBuffer(malloc(1024 * 1024), 1024 * 1024);
+    rt->FreeBuffer(malloc(100), 100);
+    rt->FreeBuffer(malloc(128), 100);
+    rt->getBufferStats(used1, cached1);
+    EXPECT_EQ(used, used1);
+    EXPECT_EQ(cached, cached1);
+}
+
+TEST(ENG(api), NewObject_Bulk)
+{
+    js::Runtime::Scope scope(rt);
+
+    exlib::string keys[] = { "a", "b", "c" };
+    js::Value values[] = { rt->NewNumber(1), rt->NewString("x"), rt->NewBoolean(true) };
+
+    js::Object o = rt->NewObject(keys, values, 3);
+    EXPECT_EQ(1, o.get("a").toNumber());
+    EXPECT_EQ("x", o.get("b").toString());
+    ASSERT_TRUE(o.get("c").toBoolean());
+
+    js::PropertyKey ka(rt, "a");
+    js::PropertyKey kb(rt, "b");
+    const js::PropertyKey* pkeys[] = { &ka, &kb };
+
+    o = rt->NewObject(pkeys, values, 2);
+    EXPECT_EQ(2, o.keys().length());
+    EXPECT_EQ("x", o.get(kb).toString());
+}
+
 TEST(ENG(api), execute)
 {
     js::Runtime::Scope scope(rt);
@@ -267,6 +436,171 @@ TEST(ENG(api), json)
     EXPECT_EQ(100, rt->execute("JSON.parse(\'{\"a\":100}\').a", "test.js").toNumber());
 }
 
+TEST(ENG(api), execute_context)
+{
+    js::Runtime::Scope scope(rt);
+
+    rt->execute("var context_test_1 = 100;", "context.js");
+    EXPECT_EQ(100, rt->GetGlobal().get("context_test_1").toNumber());
+    EXPECT_EQ(101, rt->execute("++context_test_1", "context.js").toNumber());
+
+    ASSERT_TRUE(rt->execute("context_test_1", "context.js", true).isEmpty());
+    EXPECT_EQ(10, rt->execute("var context_test_2 = 10; context_test_2", "context.js", true).toNumber());
+    ASSERT_TRUE(rt->GetGlobal().get("context_test_2").isUndefined());
+}
+
+TEST(ENG(api), execute_cache)
+{
+    js::Runtime::Scope scope(rt);
+
+    rt->execute("var cache_test_1 = 0;", "cache_init.js");
+    for (int32_t i = 0; i < 10; i++)
+        EXPECT_EQ(i + 1, rt->execute("++cache_test_1", "cache.js").toNumber());
+
+    // same name, new code
+    EXPECT_EQ(20, rt->execute("cache_test_1 * 2", "cache.js").toNumber());
+    ASSERT_TRUE(rt->execute("(", "cache.js").isEmpty());
+    EXPECT_EQ(10, rt->execute("cache_test_1", "cache.js").toNumber());
+}
+
+TEST(ENG(api), code_cache_file)
+{
+    js::Runtime::Scope scope(rt);
+    const char* fname = "jssdk_code_cache.bin";
+    const char* code = "(function(a){return a * 3;})(7) + 1";
+
+    EXPECT_EQ(22, rt->execute(code, "code_cache.js").toNumber());
+    ASSERT_TRUE(rt->saveCodeCache(fname));
+
+    rt->clearCodeCache();
+    ASSERT_TRUE(rt->loadCodeCache(fname));
+    EXPECT_EQ(22, rt->execute(code, "code_cache.js").toNumber());
+
+    int32_t consumed, rejected, consumed1, rejected1;
+
+    // data saved for other code is not used
+    rt->clearCodeCache();
+    ASSERT_TRUE(rt->loadCodeCache(fname));
+    rt->getCodeCacheStats(consumed, rejected);
+    EXPECT_EQ(5, rt->execute("2+3", "code_cache.js").toNumber());
+    rt->getCodeCacheStats(consumed1, rejected1);
+    EXPECT_EQ(consumed, consumed1);
+    EXPECT_EQ(rejected, rejected1);
+
+    ASSERT_FALSE(rt->loadCodeCache("jssdk_no_such_cache.bin"));
+
+    // a fresh runtime has no compilation cache of its own to fall back on
+    js::Runtime* rt1 = js::_api->createRuntime();
+    {
+        js::Runtime::Scope scope1(rt1);
+
+        ASSERT_TRUE(rt1->loadCodeCache(fname));
+        EXPECT_EQ(22, rt1->execute(code, "code_cache.js").toNumber());
+        rt1->getCodeCacheStats(consumed, rejected);
+        EXPECT_EQ(1, consumed);
+        EXPECT_EQ(0, rejected);
+    }
+    rt1->destroy();
+
+    remove(fname);
+}
+
+static void write_file(const char* fname, const exlib::string& data)
+{
+    FILE* fp = fopen(fname, "wb");
+
+    fwrite(data.c_str(), 1, data.length(), fp);
+    fclose(fp);
+}
+
+TEST(ENG(api), code_cache_corrupt)
+{
+    js::Runtime::Scope scope(rt);
+    const char* fname = "jssdk_code_cache.bin";
+    const char* code = "(function(a){return a * 5;})(7) + 1";
+    exlib::string data;
+    char buf[4096];
+    size_t n;
+
+    EXPECT_EQ(36, rt->execute(code, "code_cache_corrupt.js").toNumber());
+    ASSERT_TRUE(rt->saveCodeCache(fname));
+
+    FILE* fp = fopen(fname, "rb");
+    ASSERT_TRUE(fp != NULL);
+    while ((n = fread(buf, 1, sizeof(buf), fp)) > 0)
+        data.append(buf, n);
+    fclose(fp);
+    ASSERT_GT(data.length(), 12u);
+
+    // cut inside the data of the last entry
+    write_file(fname, exlib::string(data.c_str(), data.length() - 1));
+    EXPECT_FALSE(rt->loadCodeCache(fname));
+
+    // a name length far past the end of the file
+    exlib::string bad(data.c_str(), 4);
+    bad.append("\xf0\xff\xff\xff", 4);
+    bad.append(data.c_str() + 8, data.length() - 8);
+    write_file(fname, bad);
+    EXPECT_FALSE(rt->loadCodeCache(fname));
+
+    // the data length of the first entry made huge
+    uint32_t name_len;
+    memcpy(&name_len, data.c_str() + 4, sizeof(name_len));
+    bad = data;
+    memcpy(&bad[4 + 4 + name_len + 8], "\xf0\xff\xff\xff", 4);
+    write_file(fname, bad);
+    EXPECT_FALSE(rt->loadCodeCache(fname));
+
+    // only the magic
+    write_file(fname, exlib::string(data.c_str(), 2));
+    EXPECT_FALSE(rt->loadCodeCache(fname));
+
+    write_file(fname, data);
+    EXPECT_TRUE(rt->loadCodeCache(fname));
+    EXPECT_EQ(36, rt->execute(code, "code_cache_corrupt.js").toNumber());
+
+    remove(fname);
+}
+
+TEST(ENG(api), RuntimePool)
+{
+    exlib::string snapshot;
+
+    ASSERT_TRUE(js::_api->createSnapshot("var snapshot_test = 100;"
+                                         "function snapshot_fn(a) { return a + snapshot_test; }",
+                                         "snapshot_fn(1);", snapshot));
+
+    js::RuntimePool pool(js::_api, snapshot, 2);
+    EXPECT_EQ(2, pool.idle());
+
+    js::Runtime* rt1 = pool.acquire();
+    js::Runtime* rt2 = pool.acquire();
+    js::Runtime* rt3 = pool.acquire();
+    EXPECT_EQ(0, pool.idle());
+
+    {
+        js::Runtime::Scope scope(rt1);
+
+        EXPECT_EQ(105, rt1->execute("snapshot_fn(5)", "pool.js").toNumber());
+        rt1->execute("snapshot_test = 1; var pool_test = 1;", "pool.js");
+        EXPECT_EQ(6, rt1->execute("snapshot_fn(5)", "pool.js").toNumber());
+    }
+
+    pool.release(rt1);
+    pool.release(rt2);
+    pool.release(rt3);
+    EXPECT_EQ(2, pool.idle());
+
+    rt1 = pool.acquire();
+    {
+        js::Runtime::Scope scope(rt1);
+
+        EXPECT_EQ(105, rt1->execute("snapshot_fn(5)", "pool.js").toNumber());
+        ASSERT_TRUE(rt1->GetGlobal().get("pool_test").isUndefined());
+    }
+    pool.release(rt1);
+}
+
 TEST(ENG(api), DestroyRuntime)
 {
     rt->destroy();
@@ -33,7 +33,7 @@ endif()
 if(${BUILD_TYPE} STREQUAL "release")
 	set(flags "${flags} -O3 -s ${BUILD_OPTION} -w -fvisibility=hidden")
 
-	if(${OS} STREQUAL "FreeBSD")
+	if(${OS} STREQUAL "FreeBSD" OR ${OS} STREQUAL "Linux")
 		set(flags "${flags} -fno-omit-frame-pointer")
 	else()
 		set(flags "${flags} -fomit-frame-pointer")
@@ -1,5 +1,6 @@
 
 #include "condition-variable.h"
+#include "time.h"
 
 namespace v8 {
 namespace base {
@@ -28,8 +29,8 @@ void ConditionVariable::Wait(Mutex* mutex) {
 
 
 bool ConditionVariable::WaitFor(Mutex* mutex, const TimeDelta& rel_time) {
-  native_handle_.wait(mutex->native_handle());
-  return true;
+  int64_t us = rel_time.InMicroseconds();
+  return native_handle_.wait(mutex->native_handle(), us < 0 ? 0 : us);
 }
 
 } }  // namespace v8::base
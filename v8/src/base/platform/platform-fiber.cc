@@ -43,6 +43,9 @@ namespace base {
     private:
         void _run()
         {
+            // v8 only starts background helpers (compiler, gc, wasm) here,
+            // keep them from delaying script fibers
+            exlib::Fiber::current()->set_priority(exlib::Fiber::PRIORITY_BATCH);
             thread->NotifyStartedAndRun();
         }
 
@@ -105,7 +108,7 @@ namespace base {
 
     void OS::Sleep(TimeDelta interval)
     {
-        exlib::Fiber::sleep(interval.InMicroseconds());
+        exlib::Fiber::usleep(interval.InMicroseconds());
     }
 }
 }
@@ -27,11 +27,8 @@ void Semaphore::Wait()
 
 bool Semaphore::WaitFor(const TimeDelta& rel_time)
 {
-	if (rel_time.InMicroseconds() == 0)
-		return native_handle_.trywait();
-
-	native_handle_.wait();
-	return true;
+	int64_t us = rel_time.InMicroseconds();
+	return native_handle_.wait(us < 0 ? 0 : us);
 }
 
 }